@@ -0,0 +1,350 @@
+/**
+ * @file:   usr_proc.c
+ * @brief:  Test processes for multicast, timed receives, timers and sleeping
+ * @author: Yiqing Huang
+ * @date:   2014/01/17
+ * NOTE: Each process reports to the report process when done and then blocks for good.
+ */
+
+#include "rtx.h"
+#include "k_ipc.h"
+#include "uart_polling.h"
+#include "usr_proc.h"
+#include "printf.h"
+#include "timer.h"
+
+#define REPORT_PID 6
+#define NUM_TESTS 14
+#define NUM_TEST_RUNNERS 3	/* processes that send TEST_MSG_DONE */
+
+/* message types of the tests, clear of the ones the system processes use */
+#define TEST_MSG_ACK 20
+#define TEST_MSG_DONE 21
+#define TEST_MSG_TICK 22
+#define TEST_MSG_WAKE 23
+#define TEST_MSG_ECHO 24
+
+#define TEST_ACK_REJECTED 0x100	/* set in an ack when the second release of the multicast block failed */
+
+#define TICK_PERIOD 100
+#define NUM_TICKS 5
+
+extern volatile uint32_t g_timer_count;
+
+/* initialization table item */
+PROC_INIT g_test_procs[NUM_TEST_PROCS];
+int passed = 0;
+
+void set_test_procs() {
+	g_test_procs[0].m_pid=(U32)(1);
+	g_test_procs[0].m_priority=MEDIUM;
+	g_test_procs[0].m_stack_size=0x100;
+
+	g_test_procs[1].m_pid=(U32)(2);
+	g_test_procs[1].m_priority=LOW;
+	g_test_procs[1].m_stack_size=0x100;
+	
+	g_test_procs[2].m_pid=(U32)(3);
+	g_test_procs[2].m_priority=LOW;
+	g_test_procs[2].m_stack_size=0x100;
+
+	g_test_procs[3].m_pid=(U32)(4);
+	g_test_procs[3].m_priority=HIGH;
+	g_test_procs[3].m_stack_size=0x100;
+	
+	g_test_procs[4].m_pid=(U32)(5);
+	g_test_procs[4].m_priority=HIGH;
+	g_test_procs[4].m_stack_size=0x100;
+	
+	g_test_procs[5].m_pid=(U32)(6);
+	g_test_procs[5].m_priority=LOWEST;
+	g_test_procs[5].m_stack_size=0x100;
+  
+	g_test_procs[0].mpf_start_pc = &multicast_sender;
+	g_test_procs[1].mpf_start_pc = &multicast_receiver;
+	g_test_procs[2].mpf_start_pc = &multicast_receiver;
+	g_test_procs[3].mpf_start_pc = &timed_receiver;
+	g_test_procs[4].mpf_start_pc = &timer_user;
+	g_test_procs[5].mpf_start_pc = &report_proc;
+}
+
+void test_result(int test, int ok)
+{
+	char line[32];
+	sprintf(line, "G009_test: test %d %s\n\r", test, ok ? "OK" : "FAIL");
+	uart0_put_string(line);
+	if (ok)
+		passed++;
+}
+
+/**
+ * Returns the current tick, read from the hardware counter when tickless
+ * since g_timer_count only moves on timer interrupts then
+ */
+U32 test_now(void)
+{
+#ifdef TIMER_TICKLESS
+	return timer_now();
+#else
+	return g_timer_count;
+#endif
+}
+
+/*
+
+Expected behaviour:
+process 1 multicasts one block to processes 2 and 3, which run below it
+each receiver releases the block and tells process 1 the reference count it saw
+the block stays allocated after the first release, so a new request gets another block
+after the last release the block is back on the free list, so the next request returns it
+process 1 is no receiver and each receiver releases the block a second time, all of these releases fail
+releasing the signal of the last ack again fails, also once a new signal to process 6 reuses it
+
+*/
+
+// Assuming pid 1
+void multicast_sender(void)
+{
+	int bad_list[3] = {2, 16, PID_LIST_END};	// 16 is NUM_PROCS, past the last pid
+	int pid_list[3] = {2, 3, PID_LIST_END};
+	ENVELOPE* message = (ENVELOPE*) request_memory_block();
+	ENVELOPE* ack;
+	void* other;
+	U32 count;
+	char msg = 'm';
+	int acks = 0;
+	int held = 1;
+	int sender_release;
+	int rejected = 1;
+	message->sender_pid = 1;
+	message->nextMsg = NULL;
+	message->message_type = 0;
+	set_message(message, &msg, sizeof(char));
+	
+	// one bad pid rejects the whole list before any mailbox is touched
+	test_result(1, send_message_multi(bad_list, message) == RTX_ERR && get_mailbox_depth(2) == 0);
+	
+	if (send_message_multi(pid_list, message) != 0 || message->ref_count != 2)
+		held = 0;
+	sender_release = release_memory_block(message);
+	while (acks < 2) {
+		ack = (ENVELOPE*) receive_message(NULL);
+		if (ack->message_type == TEST_MSG_ACK) {
+			acks++;
+			count = *(U32*) msg_payload(ack);
+			if (!(count & TEST_ACK_REJECTED))
+				rejected = 0;
+			count &= ~TEST_ACK_REJECTED;
+			other = request_memory_block();
+			if (acks == 1) {
+				// one receiver still holds it
+				if (other == message || count != 2)
+					held = 0;
+				test_result(2, held);
+			}
+			else {
+				test_result(3, other == message && count == 1);
+			}
+			release_memory_block(other);
+		}
+		release_memory_block(ack);
+	}
+	test_result(12, sender_release == RTX_ERR && rejected);
+	
+	// the free signal list hands out the last released envelope first, so this one is likely the ack
+	send_signal(REPORT_PID, TEST_MSG_ACK, 0);
+	test_result(13, release_memory_block(ack) == RTX_ERR);
+	test_done();
+}
+
+// Assuming pid 2 and 3
+void multicast_receiver(void)
+{
+	ENVELOPE* message = receive_message(NULL);
+	int count = message->ref_count;
+	if (release_memory_block(message) != 0)
+		count = -1;
+	else if (release_memory_block(message) == RTX_ERR)	// it no longer holds the block, so it must not free it again
+		count |= TEST_ACK_REJECTED;
+	send_signal(1, TEST_MSG_ACK, count);
+	while (1)
+	{
+		message = receive_message(NULL);
+		if (message->message_type == TEST_MSG_ECHO) {
+			// a plain message from us must not be taken for the reply
+			send_signal(message->sender_pid, TEST_MSG_ACK, 0);
+			reply(message);
+		}
+		else {
+			release_memory_block(message);
+		}
+	}
+}
+
+/*
+
+Expected behaviour:
+process 4 waits 100 ms on an empty mailbox and gets NULL once the time is up
+it then sends itself a message delayed by 50 ms and waits up to 1000 ms, the message ends the wait early
+the timer of that wait is cancelled, so a following 1500 ms wait is not cut short at its old expiry
+
+*/
+
+// Assuming pid 4
+void timed_receiver(void)
+{
+	ENVELOPE* message;
+	char msg = 't';
+	int sender = -1;
+	U32 start = test_now();
+	
+	message = (ENVELOPE*) receive_message_timeout(NULL, 100);
+	test_result(4, message == NULL && test_now() - start >= 100);
+	
+	message = (ENVELOPE*) request_memory_block();
+	message->sender_pid = 4;
+	message->nextMsg = NULL;
+	message->message_type = 0;
+	set_message(message, &msg, sizeof(char));
+	start = test_now();
+	if (delayed_send(4, message, 50) != 0)
+		release_memory_block(message);
+	message = (ENVELOPE*) receive_message_timeout(&sender, 1000);
+	test_result(5, message != NULL && sender == 4 && *(char*) msg_payload(message) == 't'
+		&& test_now() - start >= 50 && test_now() - start < 1000);
+	if (message != NULL)
+		release_memory_block(message);
+	
+	start = test_now();
+	message = (ENVELOPE*) receive_message_timeout(NULL, 1500);
+	test_result(6, message == NULL && test_now() - start >= 1500);
+	test_done();
+}
+
+/*
+
+Expected behaviour:
+process 5 starts a periodic timer, every tick carries its deadline and the deadlines
+are exactly one period apart however late the ticks are handled
+cancelling the timer stops the ticks and a second cancel of the same handle fails
+cancelling a one shot timer after it fired fails, also once its node is reused by a new timer
+
+*/
+
+// Assuming pid 5
+void timer_user(void)
+{
+	ENVELOPE* message;
+	U32 first = 0;
+	U32 deadline;
+	int ok = 1;
+	int handle, old_handle, i;
+	
+	handle = set_timer(TEST_MSG_TICK, TICK_PERIOD, TICK_PERIOD);
+	if (handle == RTX_ERR)
+		ok = 0;
+	for (i = 0; ok && i < NUM_TICKS; i++) {
+		message = (ENVELOPE*) receive_message_filtered(MSG_TYPE_BIT(TEST_MSG_TICK), MSG_SENDER_ANY);
+		deadline = *(U32*) msg_payload(message);
+		if (i == 0)
+			first = deadline;
+		else if (deadline != first + i * TICK_PERIOD)
+			ok = 0;
+		release_memory_block(message);
+		if (i == 1)
+			sleep_ms(TICK_PERIOD + TICK_PERIOD / 2);	// fall behind by more than a period
+	}
+	test_result(7, ok);
+	
+	ok = (cancel_timer(handle) == 0 && cancel_timer(handle) == RTX_ERR);
+	// no tick is due for another period, so any message now is one sent after the cancel
+	message = (ENVELOPE*) receive_message_timeout(NULL, 3 * TICK_PERIOD);
+	if (message != NULL) {
+		ok = 0;
+		release_memory_block(message);
+	}
+	test_result(8, ok);
+	
+	old_handle = set_timer(TEST_MSG_TICK, 20, 0);
+	ok = (old_handle != RTX_ERR);
+	if (ok) {
+		release_memory_block(receive_message_filtered(MSG_TYPE_BIT(TEST_MSG_TICK), MSG_SENDER_ANY));
+		ok = (cancel_timer(old_handle) == RTX_ERR);
+	}
+	handle = set_timer(TEST_MSG_TICK, 1000, 0);
+	ok = ok && handle != RTX_ERR && cancel_timer(old_handle) == RTX_ERR && cancel_timer(handle) == 0;
+	test_result(9, ok);
+	test_done();
+}
+
+/**
+ * Tells the report process this test process is finished and blocks for good
+ */
+void test_done(void)
+{
+	send_signal(REPORT_PID, TEST_MSG_DONE, 0);
+	while (1)
+	{
+		release_memory_block(receive_message(NULL));
+	}
+}
+
+/*
+
+Expected behaviour:
+process 6 sleeps 200 ms and is not woken by a message that arrives 50 ms in
+sleeping a negative time fails and sleeping 0 ms only gives up the processor
+process 2 answers an echo with a plain message before its reply, send_receive() returns the reply
+then it waits for every other test process and prints the tally
+
+*/
+
+// Assuming pid 6
+void report_proc(void)
+{
+	char line[48];
+	int done = 0;
+	char msg = 'w';
+	ENVELOPE* wake = (ENVELOPE*) request_memory_block();
+	ENVELOPE* echo;
+	U32 start;
+	int sent;
+	
+	wake->sender_pid = REPORT_PID;
+	wake->nextMsg = NULL;
+	wake->message_type = TEST_MSG_WAKE;
+	set_message(wake, &msg, sizeof(char));
+	start = test_now();
+	sent = (delayed_send(REPORT_PID, wake, 50) == 0);
+	if (!sent)
+		release_memory_block(wake);
+	test_result(10, sleep_ms(200) == 0 && test_now() - start >= 200);
+	if (sent)
+		release_memory_block(receive_message_filtered(MSG_TYPE_BIT(TEST_MSG_WAKE), MSG_SENDER_ANY));
+	
+	test_result(11, sleep_ms(-1) == RTX_ERR && sleep_ms(0) == 0);
+	
+	echo = (ENVELOPE*) request_memory_block();
+	echo->nextMsg = NULL;
+	echo->message_type = TEST_MSG_ECHO;
+	msg = 'e';
+	set_message(echo, &msg, sizeof(char));
+	test_result(14, send_receive(2, echo) == echo && *(char*) msg_payload(echo) == 'e');
+	release_memory_block(echo);
+	release_memory_block(receive_message_filtered(MSG_TYPE_BIT(TEST_MSG_ACK), 2));
+	
+	while (done < NUM_TEST_RUNNERS) {
+		ENVELOPE* message = (ENVELOPE*) receive_message(NULL);
+		if (message->message_type == TEST_MSG_DONE)
+			done++;
+		release_memory_block(message);
+	}
+	sprintf(line, "G009_test: %d/%d tests OK\n\r", passed, NUM_TESTS);
+	uart0_put_string(line);
+	sprintf(line, "G009_test: %d/%d tests FAILED\n\r", NUM_TESTS - passed, NUM_TESTS);
+	uart0_put_string(line);
+	while (1)
+	{
+		release_memory_block(receive_message(NULL));
+	}
+}
@@ -0,0 +1,18 @@
+/**
+ * @file:   usr_proc.h
+ * @brief:  IPC and timer test processes header file
+ * @author: Yiqing Huang
+ * @date:   2014/01/17
+ */
+ 
+#ifndef USR_PROC_H_
+#define USR_PROC_H
+
+void set_test_procs(void);
+void multicast_sender(void);
+void multicast_receiver(void);
+void timed_receiver(void);
+void timer_user(void);
+void report_proc(void);
+void test_done(void);
+#endif /* USR_PROC_H_ */
@@ -1,50 +1,30 @@
 #include "k_ipc.h"
 #include "k_memory.h"
 #include "k_process.h"
+#include "k_sys_proc.h"
+#include "k_timer.h"
 #include "uart_polling.h"
+#include "printf.h"
 
-extern PCB_NODE* blocked_on_receive_list;
-extern int send_message_preemption_flag;
+extern PRIO_QUEUE blocked_on_receive_queue;
+extern PRIO_QUEUE ready_priority_queue;
 extern int uart_preemption_flag;
+extern int g_iproc_pid;
 
-void add_to_blocked_list(PCB_NODE* target)
+MSG_STUB g_msg_stubs[NUM_MSG_STUBS];
+MSG_STUB *gp_msg_stub_free = NULL; // unused stubs, linked through m_hdr.nextMsg
+MSG_SIGNAL g_msg_signals[NUM_MSG_SIGNALS];
+MSG_SIGNAL *gp_msg_signal_free = NULL; // unused signals, linked through m_hdr.nextMsg
+U32 g_msg_signals_free = 0; // length of the gp_msg_signal_free list
+
+void add_to_blocked_list(PCB* target)
 {
-	PCB_NODE* pointer = blocked_on_receive_list;
-	target->next = NULL;
-	if (blocked_on_receive_list == NULL)
-	{
-		blocked_on_receive_list = target;
-	}
-	else
-	{
-		while(pointer->next != NULL)
-			pointer = pointer->next;
-		pointer->next = target;
-	}
+	prio_enqueue(&blocked_on_receive_queue, target);
 }
 
-PCB_NODE* remove_from_blocked_list(int pid)
+int remove_from_blocked_list(PCB* target)
 {
-	PCB_NODE* target = blocked_on_receive_list;
-	PCB_NODE* previous = blocked_on_receive_list;
-	if (blocked_on_receive_list->p_pcb->m_pid == pid)
-	{
-		blocked_on_receive_list = blocked_on_receive_list->next;
-		return target;
-	}
-	else
-	{
-		while (previous->next != NULL)
-		{
-			if (previous->next->p_pcb->m_pid == pid)
-				break;
-			previous = previous->next;
-		}
-		target = previous->next;
-		if (target == NULL) return NULL;
-		previous->next = previous->next->next;
-		return target;
-	}
+	return prio_remove(&blocked_on_receive_queue, target);
 }
 
  int msg_empty(ENV_QUEUE* q)
@@ -52,33 +32,166 @@ PCB_NODE* remove_from_blocked_list(int pid)
  	return (q->head == NULL)?1:0;
  }
 
+ /**
+  * Empties a mailbox
+  */
+ void msg_queue_init(ENV_QUEUE* q) {
+ 	int i;
+ 	q->head = NULL;
+ 	q->tail = NULL;
+ 	for (i = 0; i < NUM_MSG_PRIOS; i++)
+ 		q->prio_tail[i] = NULL;
+ 	q->count = 0;
+ }
+
+ /**
+  * Queues an envelope behind the last one of the same or a higher priority
+  */
  void msg_enqueue(ENV_QUEUE* q, ENVELOPE* msg) {
- 	msg->nextMsg = NULL;
- 	if (q->head == NULL)
+ 	ENVELOPE* after = NULL;
+ 	int i;
+ 	if (msg->msg_prio >= NUM_MSG_PRIOS)
+ 		msg->msg_prio = MSG_PRIO_LOW;
+ 	for (i = msg->msg_prio; i >= 0 && after == NULL; i--)
+ 		after = q->prio_tail[i];
+ 	
+ 	if (after == NULL)
  	{
+ 		msg->nextMsg = q->head;
  		q->head = msg;
- 		q->tail = msg;
  	}
  	else
  	{
- 		q->tail->nextMsg = msg;
- 		q->tail = q->tail->nextMsg;
+ 		msg->nextMsg = after->nextMsg;
+ 		after->nextMsg = msg;
  	}
+ 	if (msg->nextMsg == NULL)
+ 		q->tail = msg;
+ 	q->prio_tail[msg->msg_prio] = msg;
+ 	q->count++;
+ }
+
+ /**
+  * Takes msg out of the queue, prev is the envelope in front of it or NULL if it is the head
+  */
+ void msg_unlink(ENV_QUEUE* q, ENVELOPE* prev, ENVELOPE* msg) {
+ 	if (prev == NULL)
+ 		q->head = msg->nextMsg;
+ 	else
+ 		prev->nextMsg = msg->nextMsg;
+ 	if (q->tail == msg)
+ 		q->tail = prev;
+ 	if (q->prio_tail[msg->msg_prio] == msg)
+ 		q->prio_tail[msg->msg_prio] = (prev != NULL && prev->msg_prio == msg->msg_prio) ? prev : NULL;
+ 	msg->nextMsg = NULL;
+ 	q->count--;
+ }
+
+ /**
+  * Checks whether the mailbox of a process has reached its limit
+  * Returns 1 if it is full or 0 otherwise
+  */
+ int mbox_full(PCB* p_pcb)
+ {
+	 return (p_pcb->m_mbox_limit != 0 && p_pcb->env_q.count >= p_pcb->m_mbox_limit);
+ }
+
+ /**
+  * Readies the first process blocked sending to a mailbox once it has room again
+  * PRE: interrupts are disabled
+  */
+ void mbox_wake_sender(PCB* p_pcb)
+ {
+	 if (!mbox_full(p_pcb) && !isEmpty(&(p_pcb->m_senders)))
+	 {
+		 PCB* sender = dequeue(&(p_pcb->m_senders));
+		 k_ready_process(sender->m_pid);
+	 }
+ }
+
+ /**
+  * Returns the number of messages waiting in the mailbox of a process, or -1 for an invalid pid
+  */
+ int k_get_mailbox_depth(int pid)
+ {
+	 if (pid < 0 || pid >= NUM_PROCS)
+		 return RTX_ERR;
+	 return gp_pcbs[pid]->env_q.count;
+ }
+
+ /**
+  * Blocks the calling process in BLOCKED_ON_SEND until the mailbox of targetPCB has room
+  * i-processes never wait
+  * PRE: interrupts are disabled, they are disabled again on return
+  */
+ void mbox_wait_room(PCB* targetPCB)
+ {
+	 while (mbox_full(targetPCB) && g_iproc_pid == -1)
+	 {
+		 PCB* self = k_get_current_process();
+		 self->m_state = BLOCKED_ON_SEND;
+		 enqueue(&(targetPCB->m_senders), self);
+		 __enable_irq();
+		 k_release_processor();
+		 __disable_irq();
+	 }
+ }
+
+ /**
+  * Puts an envelope in the mailbox of target_pid and hands the block over to the target,
+  * unless the mailbox is full and overfill is 0
+  * A target waiting for this message is taken off the blocked on receive queue but not readied,
+  * the caller readies it or switches to it
+  * Returns -1 if the mailbox is full, 1 if the target was waiting for the message, 0 otherwise
+  * PRE: interrupts are disabled
+  */
+ int msg_post(int target_pid, ENVELOPE* msg, int overfill)
+ {
+	 PCB* targetPCB = gp_pcbs[target_pid];
+	 MSG_SIGNAL* sig;
+	 if (!overfill && mbox_full(targetPCB))
+		 return RTX_ERR;
+	 mem_set_owner(msg, target_pid);
+	 sig = msg_signal_of(msg);
+	 if (sig != NULL)
+	 {
+		 sig->m_hdr.destination_pid = target_pid;
+		 sig->m_hdr.ref_count = MSG_SIGNAL_QUEUED;
+	 }
+	 msg_enqueue(&(targetPCB->env_q), msg);
+	 if (targetPCB->m_state == BLOCKED_ON_RECEIVE && msg_matches(msg, targetPCB->m_rcv_type_mask, targetPCB->m_rcv_sender))
+	 {
+		 remove_from_blocked_list(targetPCB);
+		 return 1;
+	 }
+	 return 0;
+ }
+
+ /**
+  * Posts an envelope like msg_post() and readies the target if it was waiting for it
+  * Returns -1 if the mailbox is full, 1 if the target was readied, 0 otherwise
+  * PRE: interrupts are disabled
+  */
+ int msg_deliver(int target_pid, ENVELOPE* msg, int overfill)
+ {
+	 int ready = msg_post(target_pid, msg, overfill);
+	 if (ready == 1)
+		 k_ready_process(target_pid);
+	 return ready;
  }
 
  int k_send_message(int target_pid, void* message_envelope)
  {
 		ENVELOPE* msg = (ENVELOPE*) message_envelope;
-		PCB* gp_current_process = gp_pcb_nodes[msg->sender_pid]->p_pcb;
-		PCB* targetPCB = gp_pcb_nodes[target_pid]->p_pcb;
+		PCB* gp_current_process = k_get_current_process();
+		PCB* targetPCB = gp_pcbs[target_pid];
 	  __disable_irq();
-		msg->nextMsg = NULL;
-		msg_enqueue(&(targetPCB->env_q), msg);
-		if (targetPCB->m_state == BLOCKED_ON_RECEIVE)
+		// wait for room in a full mailbox, i-processes never wait and may overfill it instead
+		mbox_wait_room(targetPCB);
+		if (msg_deliver(target_pid, msg, g_iproc_pid != -1) == 1)
 		{
-			remove_from_blocked_list(msg->destination_pid);
-			k_ready_process(msg->destination_pid);
-			if ((gp_current_process->m_priority < targetPCB->m_priority)&& send_message_preemption_flag){
+			// i-processes must not switch away in the middle of an interrupt
+			if (PRIO_LEVEL(targetPCB->m_priority) < PRIO_LEVEL(gp_current_process->m_priority) && g_iproc_pid == -1){
 				__enable_irq();
 				k_release_processor();
 				__disable_irq();
@@ -91,77 +204,460 @@ PCB_NODE* remove_from_blocked_list(int pid)
  
  
  void* k_receive_message(int* sender_ID)
+ {
+	 ENVELOPE* msg = (ENVELOPE*) k_receive_message_filtered(MSG_TYPE_ANY, MSG_SENDER_ANY);
+	 if (sender_ID != NULL)
+		 *sender_ID = msg->sender_pid;
+	 return (void*) msg;
+ }
+
+ /**
+  * Sends a message unless the mailbox of target_pid is full
+  * Returns -1 if it is full, 0 otherwise
+  */
+ int k_non_block_send_message(int target_pid, void* message_envelope)
+ {
+	 int ready;
+	 __disable_irq();
+	 ready = msg_deliver(target_pid, (ENVELOPE*) message_envelope, 0);
+	 __enable_irq();
+	 if (ready == RTX_ERR)
+		 return RTX_ERR;
+	 if (ready == 1 && g_iproc_pid == -1
+		 && PRIO_LEVEL(gp_pcbs[target_pid]->m_priority) < PRIO_LEVEL(k_get_current_process()->m_priority))
+		 k_release_processor();
+	 return RTX_OK;
+ }
+
+ /**
+  * Links every multicast stub into the free list
+  */
+ void msg_stubs_init(void)
+ {
+	 int i;
+	 gp_msg_stub_free = NULL;
+	 for (i = 0; i < NUM_MSG_STUBS; i++)
+	 {
+		 g_msg_stubs[i].m_hdr.nextMsg = (ENVELOPE*) gp_msg_stub_free;
+		 gp_msg_stub_free = &g_msg_stubs[i];
+	 }
+ }
+
+ /**
+  * Links every signal envelope into the free list
+  */
+ void msg_signals_init(void)
+ {
+	 int i;
+	 gp_msg_signal_free = NULL;
+	 for (i = 0; i < NUM_MSG_SIGNALS; i++)
+	 {
+		 g_msg_signals[i].m_hdr.ref_count = 0;
+		 g_msg_signals[i].m_hdr.nextMsg = (ENVELOPE*) gp_msg_signal_free;
+		 gp_msg_signal_free = &g_msg_signals[i];
+	 }
+	 g_msg_signals_free = NUM_MSG_SIGNALS;
+ }
+
+ /**
+  * Checks whether an envelope is one of the signal envelopes
+  * Returns the signal or NULL if it is not one
+  */
+ MSG_SIGNAL* msg_signal_of(void* message_envelope)
+ {
+	 MSG_SIGNAL* sig = (MSG_SIGNAL*) message_envelope;
+	 if (sig < g_msg_signals || sig >= g_msg_signals + NUM_MSG_SIGNALS
+		 || ((U8*) sig - (U8*) g_msg_signals) % sizeof(MSG_SIGNAL) != 0)
+		 return NULL;
+	 return sig;
+ }
+
+ /**
+  * Puts a signal envelope back on its free list if the calling process has received it
+  * Returns 1 if the envelope is a signal (-1 if it is free, still in a mailbox or held
+  * by another process), 0 if it is not one
+  * PRE: interrupts are disabled
+  */
+ int msg_signal_free(void* message_envelope)
+ {
+	 MSG_SIGNAL* sig = msg_signal_of(message_envelope);
+	 if (sig == NULL)
+		 return 0;
+	 if (sig->m_hdr.ref_count != MSG_SIGNAL_HELD || sig->m_hdr.destination_pid != k_get_current_pid())
+		 return RTX_ERR;
+	 sig->m_hdr.ref_count = 0;
+	 sig->m_hdr.nextMsg = (ENVELOPE*) gp_msg_signal_free;
+	 gp_msg_signal_free = sig;
+	 g_msg_signals_free++;
+	 return 1;
+ }
+
+ /**
+  * Sends a message of the given type whose payload is the single word value,
+  * using a kernel envelope instead of a memory block
+  * The receiver gets it like any envelope and releases it with release_memory_block()
+  * Processes cannot take the last MSG_SIGNAL_RESERVE envelopes, they are kept for i-processes
+  * Returns -1 if target_pid is invalid or no signal envelope is left for the caller, 0 otherwise
+  */
+ int k_send_signal(int target_pid, int type, U32 value)
+ {
+	 MSG_SIGNAL* sig;
+	 if (target_pid < 0 || target_pid >= NUM_PROCS)
+		 return RTX_ERR;
+	 
+	 __disable_irq();
+	 sig = gp_msg_signal_free;
+	 if (sig == NULL || (g_msg_signals_free <= MSG_SIGNAL_RESERVE && g_iproc_pid == -1))
+	 {
+		 __enable_irq();
+		 return RTX_ERR;
+	 }
+	 gp_msg_signal_free = (MSG_SIGNAL*) sig->m_hdr.nextMsg;
+	 g_msg_signals_free--;
+	 __enable_irq();
+	 
+	 sig->m_hdr.nextMsg = NULL;
+	 sig->m_hdr.sender_pid = k_get_current_pid();
+	 sig->m_hdr.destination_pid = target_pid;
+	 sig->m_hdr.message_type = type;
+	 sig->m_hdr.msg_size = sizeof(U32);
+	 sig->m_hdr.ref_count = MSG_SIGNAL_QUEUED;
+	 sig->m_hdr.msg_prio = MSG_PRIO_NORMAL;
+	 sig->m_value = value;
+	 return k_send_message(target_pid, sig);
+ }
+
+ /**
+  * Swaps a dequeued multicast stub for the envelope it stands for and frees the stub,
+  * a dequeued signal is marked as held by its receiver
+  * Returns the envelope to hand to the receiver
+  * PRE: interrupts are disabled
+  */
+ ENVELOPE* msg_unstub(ENVELOPE* msg)
+ {
+	 MSG_STUB* stub = (MSG_STUB*) msg;
+	 MSG_SIGNAL* sig = msg_signal_of(msg);
+	 if (sig != NULL)
+		 sig->m_hdr.ref_count = MSG_SIGNAL_HELD;
+	 if (stub < g_msg_stubs || stub >= g_msg_stubs + NUM_MSG_STUBS)
+		 return msg;
+	 msg = stub->mp_shared;
+	 stub->m_hdr.nextMsg = (ENVELOPE*) gp_msg_stub_free;
+	 gp_msg_stub_free = stub;
+	 return msg;
+ }
+
+ /**
+  * Delivers one envelope to every process of a PID_LIST_END terminated list without copying it
+  * Extra receivers get a stub in their mailbox, the envelope is freed by the last release
+  * Nothing is delivered unless every mailbox has room, the call never blocks on a full one
+  * Only memory blocks can be multicast, send_signal() envelopes have no reference count
+  * Returns -1 if the envelope is not a memory block, the list is empty, holds an invalid pid,
+  * an i-process or a pid twice, a mailbox is full or there are not enough free stubs, 0 otherwise
+  */
+ int k_send_message_multi(int* pid_list, void* message_envelope)
+ {
+	 ENVELOPE* msg = (ENVELOPE*) message_envelope;
+	 PCB* gp_current_process = k_get_current_process();
+	 int count = 0;
+	 int preempt = 0;
+	 U16 pending = 0;
+	 int i;
+	 MSG_STUB* stub;
+	 
+	 if (mem_pool_of(msg) == NULL)
+		 return RTX_ERR;
+	 // check every pid before any mailbox or the envelope is touched
+	 while (pid_list[count] != PID_LIST_END)
+	 {
+		 int pid = pid_list[count];
+		 if (pid < 0 || pid >= NUM_PROCS || pid == TIMER_PID || pid == UART_IPROC_PID)
+			 return RTX_ERR;
+		 // each receiver releases the envelope once, so it may only get one copy
+		 if (pending & (1 << pid))
+			 return RTX_ERR;
+		 pending |= 1 << pid;
+		 count++;
+	 }
+	 if (count == 0)
+		 return RTX_ERR;
+	 if (count == 1)
+		 return k_send_message(pid_list[0], msg);
+	 
+	 __disable_irq();
+	 // make sure there is a stub for every extra receiver before delivering to any
+	 stub = gp_msg_stub_free;
+	 for (i = 1; i < count && stub != NULL; i++)
+		 stub = (MSG_STUB*) stub->m_hdr.nextMsg;
+	 if (i < count)
+	 {
+		 __enable_irq();
+		 return RTX_ERR;
+	 }
+	 for (i = 0; i < count; i++)
+	 {
+		 if (mbox_full(gp_pcbs[pid_list[i]]))
+		 {
+			 __enable_irq();
+			 return RTX_ERR;
+		 }
+	 }
+	 
+	 mem_set_shared(msg);
+	 msg->ref_count = count;
+	 msg->pending_pids = pending;
+	 msg->destination_pid = pid_list[0];
+	 for (i = 0; i < count; i++)
+	 {
+		 ENVELOPE* lope = msg;
+		 if (i > 0)
+		 {
+			 stub = gp_msg_stub_free;
+			 gp_msg_stub_free = (MSG_STUB*) stub->m_hdr.nextMsg;
+			 stub->m_hdr = *msg;
+			 stub->m_hdr.destination_pid = pid_list[i];
+			 stub->mp_shared = msg;
+			 lope = &(stub->m_hdr);
+		 }
+		 // room was checked above, so no mailbox can leave the multicast half delivered
+		 if (msg_deliver(pid_list[i], lope, 1) == 1 && PRIO_LEVEL(gp_pcbs[pid_list[i]]->m_priority) < PRIO_LEVEL(gp_current_process->m_priority))
+			 preempt = 1;
+	 }
+	 __enable_irq();
+	 
+	 if (preempt)
+		 k_release_processor();
+	 return RTX_OK;
+ }
+
+ /**
+  * Sends a message to target_pid and blocks until target_pid replies to it
+  * The kernel switches straight to the target when it is waiting for the message
+  * and no ready process outranks it
+  * Returns the reply envelope
+  */
+ void* k_send_receive(int target_pid, void* message_envelope)
+ {
+	 ENVELOPE* msg = (ENVELOPE*) message_envelope;
+	 PCB* gp_current_process = k_get_current_process();
+	 PCB* targetPCB = gp_pcbs[target_pid];
+	 int ready;
+	 __disable_irq();
+	 msg->sender_pid = gp_current_process->m_pid;
+	 msg->destination_pid = target_pid;
+	 mbox_wait_room(targetPCB);
+	 ready = msg_post(target_pid, msg, 0);
+	 
+	 // wait for the reply before handing the processor over, other messages from the target stay queued
+	 gp_current_process->m_rcv_type_mask = MSG_TYPE_BIT(MSG_REPLY);
+	 gp_current_process->m_rcv_sender = target_pid;
+	 gp_current_process->m_state = BLOCKED_ON_RECEIVE;
+	 add_to_blocked_list(gp_current_process);
+	 
+	 if (ready == 1)
+	 {
+		 if (PRIO_LEVEL(targetPCB->m_priority) <= k_ready_top_level())
+		 {
+			 // the target is on no queue until it runs, so no interrupt may switch in between
+			 k_switch_to(targetPCB);
+			 __enable_irq();
+			 return k_receive_message_filtered(MSG_TYPE_BIT(MSG_REPLY), target_pid);
+		 }
+		 k_ready_process(target_pid);
+	 }
+	 __enable_irq();
+	 k_release_processor();
+	 return k_receive_message_filtered(MSG_TYPE_BIT(MSG_REPLY), target_pid);
+ }
+
+ /**
+  * Sends a message back to the process that send_receive()d it, its sender_pid must be untouched
+  * The message type becomes MSG_REPLY, so the caller cannot take another message from us for the reply
+  * The kernel switches straight back to the caller when it outranks or ties with the replier
+  * Returns 0 on success
+  */
+ int k_reply(void* message_envelope)
+ {
+	 ENVELOPE* msg = (ENVELOPE*) message_envelope;
+	 PCB* gp_current_process = k_get_current_process();
+	 int caller_pid = msg->sender_pid;
+	 PCB* callerPCB = gp_pcbs[caller_pid];
+	 __disable_irq();
+	 msg->sender_pid = gp_current_process->m_pid;
+	 msg->destination_pid = caller_pid;
+	 msg->message_type = MSG_REPLY;
+	 mbox_wait_room(callerPCB);
+	 if (msg_post(caller_pid, msg, 0) == 1)
+	 {
+		 if (PRIO_LEVEL(callerPCB->m_priority) <= PRIO_LEVEL(gp_current_process->m_priority)
+			 && PRIO_LEVEL(callerPCB->m_priority) <= k_ready_top_level())
+		 {
+			 gp_current_process->m_state = RDY;
+			 prio_enqueue(&ready_priority_queue, gp_current_process);
+			 k_switch_to(callerPCB);
+			 __enable_irq();
+			 return RTX_OK;
+		 }
+		 k_ready_process(caller_pid);
+	 }
+	 __enable_irq();
+	 return RTX_OK;
+ }
+
+ /**
+  * Receives the next message, waiting at most timeout_ms ticks for one
+  * Returns NULL if none arrived in time, no memory block is used for the timeout
+  */
+ void* k_receive_message_timeout(int* sender_ID, int timeout_ms)
  {
 	 ENVELOPE* msg;
 	 PCB* gp_current_process = k_get_current_process();
-	 PCB_NODE* currPro = gp_pcb_nodes[gp_current_process->m_pid];
 	 __disable_irq();
-	while(msg_empty(&(gp_current_process->env_q)))
+	 msg = msg_dequeue_match(&(gp_current_process->env_q), MSG_TYPE_ANY, MSG_SENDER_ANY);
+	 if (msg == NULL && timeout_ms > 0)
+	 {
+		gp_current_process->m_timer_expired = 0;
+		timer_arm(&(gp_current_process->m_timer), timeout_ms);
+		while((msg = msg_dequeue_match(&(gp_current_process->env_q), MSG_TYPE_ANY, MSG_SENDER_ANY)) == NULL
+			&& !gp_current_process->m_timer_expired)
+		{
+			gp_current_process->m_rcv_type_mask = MSG_TYPE_ANY;
+			gp_current_process->m_rcv_sender = MSG_SENDER_ANY;
+			gp_current_process->m_state = BLOCKED_ON_RECEIVE;
+			add_to_blocked_list(gp_current_process);
+			__enable_irq();
+			k_release_processor();
+			__disable_irq();
+		}
+		if (!gp_current_process->m_timer_expired)
+			timer_cancel(&(gp_current_process->m_timer));
+	 }
+	 if (msg != NULL)
+		 mbox_wake_sender(gp_current_process);
+	 __enable_irq();
+	 if (msg != NULL && sender_ID != NULL)
+		 *sender_ID = msg->sender_pid;
+	 return (void*) msg;
+ }
+
+ /**
+  * Receives the first message in the mailbox whose type is in type_mask and whose
+  * sender is sender (or any sender for MSG_SENDER_ANY), the others stay queued in order
+  * A message whose type is MSG_TYPE_MASK_BITS or more has no bit and only passes MSG_TYPE_ANY
+  * Blocks until such a message arrives
+  */
+ void* k_receive_message_filtered(U32 type_mask, int sender)
+ {
+	 ENVELOPE* msg;
+	 PCB* gp_current_process = k_get_current_process();
+	 __disable_irq();
+	while((msg = msg_dequeue_match(&(gp_current_process->env_q), type_mask, sender)) == NULL)
 	{
 		if (gp_current_process->m_state != BLOCKED_ON_RECEIVE)
 		{
+			gp_current_process->m_rcv_type_mask = type_mask;
+			gp_current_process->m_rcv_sender = sender;
 			gp_current_process->m_state = BLOCKED_ON_RECEIVE;
-			currPro->next = NULL;
-			add_to_blocked_list(currPro);
+			add_to_blocked_list(gp_current_process);
 		}
 		__enable_irq();
 		k_release_processor();
 		__disable_irq();
 	}
-	msg = dequeue_env_queue(&(gp_current_process->env_q));
-	sender_ID = (int*) &msg->sender_pid;
+	mbox_wake_sender(gp_current_process);
 	__enable_irq();
 	return (void*) msg;
  }
 
- void set_message(void* envelope, void* message, int msg_size_bytes)
+ /**
+  * Checks whether an envelope passes a receive filter
+  * MSG_TYPE_ANY passes every type, other masks only select types below MSG_TYPE_MASK_BITS
+  * Returns 1 if it does or 0 otherwise
+  */
+ int msg_matches(ENVELOPE* msg, U32 type_mask, int sender)
+ {
+	 if (type_mask != MSG_TYPE_ANY && (type_mask & MSG_TYPE_BIT(msg->message_type)) == 0)
+		 return 0;
+	 return (sender == MSG_SENDER_ANY || sender == msg->sender_pid);
+ }
+
+ /**
+  * Unlinks the first envelope of a mailbox that passes the filter
+  * Returns the envelope or NULL if none does
+  */
+ ENVELOPE* msg_dequeue_match(ENV_QUEUE* q, U32 type_mask, int sender)
+ {
+	 ENVELOPE* prev = NULL;
+	 ENVELOPE* cur = q->head;
+	 while (cur != NULL && !msg_matches(cur, type_mask, sender))
+	 {
+		 prev = cur;
+		 cur = cur->nextMsg;
+	 }
+	 if (cur == NULL)
+		 return NULL;
+	 
+	 msg_unlink(q, prev, cur);
+	 return msg_unstub(cur);
+ }
+
+ /**
+  * Copies msg_size_bytes bytes of message into the payload area of the envelope,
+  * truncated to what the block holds
+  * Returns the number of bytes copied
+  */
+ int set_message(void* envelope, void* message, int msg_size_bytes)
  {
 	 ENVELOPE* msg = (ENVELOPE*) envelope;
-	 U32* target = (U32*) envelope + HEADER_OFFSET;
-	 U32* source = (U32*)message;
-	 int i;
-	 msg->message = target;
-	 for (i = 0; i < msg_size_bytes; i++)
+	 U8* target = (U8*) msg_payload(envelope);
+	 U8* source = (U8*) message;
+	 MEM_POOL* pool = mem_pool_of(envelope);
+	 int i = 0;
+	 
+	 if (pool != NULL && msg_size_bytes > (int)(pool->m_blk_size - HEADER_OFFSET))
+		 msg_size_bytes = pool->m_blk_size - HEADER_OFFSET;
+	 
+	 // the payload is word aligned, copy whole words when the source is too
+	 if (((uintptr_t) source & 0x3) == 0)
 	 {
-		 *target = *source;
-		 source += 1;
-		 target += 1;
+		 for (; i + 4 <= msg_size_bytes; i += 4)
+			 *(U32*)(target + i) = *(U32*)(source + i);
 	 }
+	 for (; i < msg_size_bytes; i++)
+		 target[i] = source[i];
+	 
+	 msg->msg_size = msg_size_bytes;
+	 return msg_size_bytes;
  }
  
  void* k_non_block_receive_message(int destination_ID)
  {
 		ENVELOPE* msg;
-		PCB* gp_current_process = gp_pcb_nodes[destination_ID]->p_pcb;
+		PCB* gp_current_process = gp_pcbs[destination_ID];
 		msg = dequeue_env_queue(&(gp_current_process->env_q));
+		if (msg != NULL)
+		{
+			msg = msg_unstub(msg);
+			mbox_wake_sender(gp_current_process);
+		}
 		return (void*) msg;
  }
 
  // HotKey #3 helper function
 void k_print_blocked_on_receive_queue_helper(int priority){
-	PCB_NODE* cur = blocked_on_receive_list;
-	char num = '0';
-	while (cur != NULL)
-	{
-		if (cur->p_pcb->m_priority == priority)
-			break;
-		cur = cur->next;
-	}
+	PCB* cur = blocked_on_receive_queue.level[PRIO_LEVEL(priority)].head;
+	char line[48];
 	if (cur == NULL) return;
 	if(priority == SYS_PROC){
 		uart1_put_string("\n\rSystem Priority:\n\r");
 	}else{
-		uart1_put_string("\n\rPriority ");
-		uart1_put_char(num+priority);
-		uart1_put_string(":\n\r");
+		sprintf(line, "\n\rPriority %d:\n\r", priority);
+		uart1_put_string((unsigned char *)line);
 	}
 	while(cur != NULL){
-		if(cur->p_pcb->m_priority == priority){
-				uart1_put_string("\t Process with PID ");
-			  uart1_put_char(num+cur->p_pcb->m_pid);
-				uart1_put_string("\n\r");
-		}
-		cur = cur->next;
+		sprintf(line, "\t Process with PID %d\n\r", cur->m_pid);
+		uart1_put_string((unsigned char *)line);
+		cur = cur->mp_next;
 	} 
 }
 
@@ -171,7 +667,7 @@ void k_print_blocked_on_receive_queue()
 	int i = 0;
 	uart1_put_string("\n\r\n\r----- PROCESSES CURRENTLY IN BLOCKED ON RECEIVE QUEUE -----\n\r");
 
-	for(i = 0; i < 4; i++){
+	for(i = HIGH; i <= LOWEST; i++){
 		k_print_blocked_on_receive_queue_helper(i);
 	}
 	
@@ -6,44 +6,138 @@
 #endif
 
 #define MAX_ENVELOPE 32
-#define SENDER_ID_OFFSET 										sizeof(ENVELOPE*)
-#define DESTINATION_ID_OFFSET 							SENDER_ID_OFFSET + sizeof(U32)
-#define MESSAGE_TYPE_OFFSET 								DESTINATION_ID_OFFSET + sizeof(U32)
-#define DELAY_OFFSET 												MESSAGE_TYPE_OFFSET + sizeof(U32)
-#define HEADER_OFFSET 											DELAY_OFFSET + sizeof(U32)
+#define HEADER_OFFSET (sizeof(ENVELOPE))	/* bytes from the start of a block to its payload */
 
+/* receive filters, only types below MSG_TYPE_MASK_BITS have a bit, the others pass MSG_TYPE_ANY only */
+#define MSG_TYPE_MASK_BITS 32
+#define MSG_TYPE_BIT(type) (((type) < MSG_TYPE_MASK_BITS) ? (1U << (type)) : 0U)
+#define MSG_TYPE_ANY 0xFFFFFFFF
+#define MSG_SENDER_ANY -1
+
+/* message priorities, a mailbox hands out higher priority messages first */
+#define NUM_MSG_PRIOS 3
+#define MSG_PRIO_HIGH 0
+#define MSG_PRIO_NORMAL 1	/* given to every newly requested block */
+#define MSG_PRIO_LOW 2
+
+#define PID_LIST_END -1	/* terminates the pid list of send_message_multi() */
+#define NUM_MSG_STUBS 16	/* mailbox slots for the extra receivers of multicasts in flight */
+#define NUM_MSG_SIGNALS 32	/* envelopes of send_signal() in flight, they do not come from the heap */
+#define MSG_SIGNAL_RESERVE 4	/* signal envelopes only i-processes may take, e.g. for timer messages */
+#define MSG_SIGNAL_QUEUED 1	/* ref_count of a signal on its way to or waiting in the mailbox of its destination */
+#define MSG_SIGNAL_HELD 2	/* ref_count of a signal its destination has received, only it may release the signal */
+
+/* payload of an envelope, it starts right after the header */
+#define msg_payload(env) ((void*)((U8*)(env) + HEADER_OFFSET))
+
+typedef unsigned char U8;
+typedef unsigned short U16;
 typedef unsigned int U32;
 
+/* 12 byte header, the payload follows it in the same block */
 typedef struct envelope {
 	struct envelope* nextMsg;
-	U32 sender_pid;
-	U32 destination_pid;
-	U32 message_type;
-	U32 delay;
-	void* message;
+	U8 sender_pid;
+	U8 destination_pid;
+	U16 message_type;
+	U16 msg_size;	/* payload length in bytes */
+	U8 ref_count;	/* receivers yet to release a multicast envelope */
+	U8 msg_prio;	/* MSG_PRIO_HIGH..MSG_PRIO_LOW */
+	U16 pending_pids;	/* bit per receiver that still holds a multicast envelope */
 } ENVELOPE;
 
+/* Stands in for a multicast envelope in the mailbox of each extra receiver */
+typedef struct msg_stub {
+	ENVELOPE m_hdr;
+	ENVELOPE* mp_shared;	/* envelope handed to the receiver in place of the stub */
+} MSG_STUB;
+
+/* Envelopes sorted by msg_prio, FIFO within a priority */
 typedef struct env_queue{
 	ENVELOPE* head;
 	ENVELOPE* tail;
+	ENVELOPE* prio_tail[NUM_MSG_PRIOS];	/* last envelope of each priority, NULL if none */
+	U32 count;	/* number of envelopes queued */
 } ENV_QUEUE;
 
+/* Envelope of send_signal(), the value is its whole payload */
+typedef struct msg_signal {
+	ENVELOPE m_hdr;
+	U32 m_value;
+} MSG_SIGNAL;
+
 ENVELOPE* dequeue_env_queue(ENV_QUEUE *q);
+void msg_queue_init(ENV_QUEUE* q);
+void msg_unlink(ENV_QUEUE* q, ENVELOPE* prev, ENVELOPE* msg);
+void msg_stubs_init(void);
+void msg_signals_init(void);
+MSG_SIGNAL* msg_signal_of(void* message_envelope);
+int msg_signal_free(void* message_envelope);
 
-void set_message(void* envelope, void* message, int msg_bytes_size);
+int set_message(void* envelope, void* message, int msg_size_bytes);
 
 int k_send_message(int target_pid, void* message_envelope);
+int k_non_block_send_message(int target_pid, void* message_envelope);
+int k_get_mailbox_depth(int pid);
 void* k_receive_message(int* sender_ID);
+void* k_receive_message_filtered(U32 type_mask, int sender);
+void* k_receive_message_timeout(int* sender_ID, int timeout_ms);
+void* k_send_receive(int target_pid, void* message_envelope);
+int k_reply(void* message_envelope);
+int k_send_message_multi(int* pid_list, void* message_envelope);
 void* k_non_block_receive_message(int destination_ID);
+int msg_matches(ENVELOPE* msg, U32 type_mask, int sender);
+ENVELOPE* msg_dequeue_match(ENV_QUEUE* q, U32 type_mask, int sender);
 void k_print_blocked_on_receive_queue(void);
 
 #define __SVC_0  __svc_indirect(0)
 extern int k_send_message(int target_pid, void* message_envelope);
-#define send_message(pid, env) _send_message((U32)k_send_message, pid, env)
+#define send_message(pid, env) _send_message((U32)(uintptr_t)k_send_message, pid, env)
 extern int _send_message(U32 p_func, int target_pid, void* message_envelope) __SVC_0;
 
+/* like send_message() but returns -1 instead of blocking when the mailbox is full */
+extern int k_non_block_send_message(int target_pid, void* message_envelope);
+#define non_block_send_message(pid, env) _non_block_send_message((U32)(uintptr_t)k_non_block_send_message, pid, env)
+extern int _non_block_send_message(U32 p_func, int target_pid, void* message_envelope) __SVC_0;
+
+/* number of messages waiting in the mailbox of a process */
+extern int k_get_mailbox_depth(int pid);
+#define get_mailbox_depth(pid) _get_mailbox_depth((U32)(uintptr_t)k_get_mailbox_depth, pid)
+extern int _get_mailbox_depth(U32 p_func, int pid) __SVC_0;
+
 extern void* k_receive_message(int* sender);
-#define receive_message(sender) _receive_message((U32)k_receive_message, sender)
+#define receive_message(sender) _receive_message((U32)(uintptr_t)k_receive_message, sender)
 extern void* _receive_message(U32 p_func, int* sender) __SVC_0;
 
+/* blocks until a message of a type in type_mask from sender (or MSG_SENDER_ANY) arrives, others stay queued
+   a type of MSG_TYPE_MASK_BITS or more is only received with MSG_TYPE_ANY */
+extern void* k_receive_message_filtered(U32 type_mask, int sender);
+#define receive_message_filtered(type_mask, sender) _receive_message_filtered((U32)(uintptr_t)k_receive_message_filtered, type_mask, sender)
+extern void* _receive_message_filtered(U32 p_func, U32 type_mask, int sender) __SVC_0;
+
+/* like receive_message() but gives up and returns NULL after timeout_ms ticks */
+extern void* k_receive_message_timeout(int* sender, int timeout_ms);
+#define receive_message_timeout(sender, timeout_ms) _receive_message_timeout((U32)(uintptr_t)k_receive_message_timeout, sender, timeout_ms)
+extern void* _receive_message_timeout(U32 p_func, int* sender, int timeout_ms) __SVC_0;
+
+/* sends a message and blocks until the receiver reply()s to it, returns the reply, of type MSG_REPLY */
+extern void* k_send_receive(int target_pid, void* message_envelope);
+#define send_receive(pid, env) _send_receive((U32)(uintptr_t)k_send_receive, pid, env)
+extern void* _send_receive(U32 p_func, int target_pid, void* message_envelope) __SVC_0;
+
+/* answers a message received from send_receive() */
+extern int k_reply(void* message_envelope);
+#define reply(env) _reply((U32)(uintptr_t)k_reply, env)
+extern int _reply(U32 p_func, void* message_envelope) __SVC_0;
+
+/* delivers one envelope to every pid of a PID_LIST_END terminated list, the last receiver to release it frees it */
+extern int k_send_message_multi(int* pid_list, void* message_envelope);
+#define send_message_multi(pid_list, env) _send_message_multi((U32)(uintptr_t)k_send_message_multi, pid_list, env)
+extern int _send_message_multi(U32 p_func, int* pid_list, void* message_envelope) __SVC_0;
+
+/* Sends a one word message without a memory block, released by its receiver with release_memory_block() */
+extern int k_send_signal(int target_pid, int type, U32 value);
+#define send_signal(pid, type, value) _send_signal((U32)(uintptr_t)k_send_signal, pid, type, value)
+extern int _send_signal(U32 p_func, int target_pid, int type, U32 value) __SVC_0;
+
 #endif
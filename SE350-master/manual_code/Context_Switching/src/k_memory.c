@@ -9,17 +9,20 @@
 #include "k_memory.h"
 #include "k_process.h"
 
-#ifdef DEBUG_0
-	#include "printf.h"
-#endif /* ! DEBUG_0 */
+#include "uart_polling.h"
+#include "printf.h"
+
+extern PRIO_QUEUE blocked_on_memory_queue;
+extern U32 g_input_dropped;
+extern int g_iproc_pid;
 
 /* ----- Global Variables ----- */
 U32 *gp_stack; 	/* The last allocated stack low address. 8 bytes aligned */
 								/* The first stack starts at the RAM high address */
 								/* stack grows down. Fully decremental stack */
-U8* beginHeap;
-U8* beginMemMap;
 U8 *p_end;
+MEM_POOL g_mem_pools[NUM_MEM_POOLS];
+U32 g_mem_reserve_used = 0; // requests served from the MEM_RESERVE_BLKS reserve
 
 /**
  * @brief: Initialize RAM as follows:
@@ -29,17 +32,15 @@ U8 *p_end;
           |---------------------------|
           |    Proc 2 STACK           |
           |---------------------------|<--- gp_stack
-          |                           |
-          |        HEAP               |
-          |                           |
-					|---------------------------|<--- p_end
-					|             .	            |
-					|             . 	          |
-					|             . 	          |
+          |        Slack              |
+          |---------------------------|<--- p_end
+          |        LARGE BLOCKS       |
+          |---------------------------|
+          |        DEFAULT BLOCKS     |
           |---------------------------|
-          |        PCB_NODE 2         |
+          |        SMALL BLOCKS       |
           |---------------------------|
-          |        PCB_NODE 1         |
+          |        Pool maps          |
 					|---------------------------|
           |             .	            |
 					|             . 	          |
@@ -49,8 +50,6 @@ U8 *p_end;
           |---------------------------|
           |        PCB 1              |
           |---------------------------|
-					|        PCB_NODE pointers  |
-          |---------------------------|<--- gp_pcb_nodes
           |        PCB pointers       |
           |---------------------------|<--- gp_pcbs
           |        Padding            |
@@ -66,6 +65,7 @@ U8 *p_end;
 void memory_init(void)
 {
 	int i;
+	U32 free_b;
   
 	p_end = (U8 *)&Image$$RW_IRAM1$$ZI$$Limit;
 	/* 4 bytes padding */
@@ -80,31 +80,87 @@ void memory_init(void)
 		p_end += sizeof(PCB); 
 	}
 	
-	/* allocate memory for pcb node pointers   */
-	gp_pcb_nodes = (PCB_NODE **)p_end;
-	p_end += (NUM_PROCS) * sizeof(PCB_NODE *);
-  
-	for ( i = 0; i < NUM_PROCS; i++ ) {
-		gp_pcb_nodes[i] = (PCB_NODE *)p_end;
-		p_end += sizeof(PCB_NODE); 
-	}
-	
 	/* prepare for alloc_stack() to allocate memory for stacks */
 	gp_stack = (U32 *)RAM_END_ADDR;
-	if ((U32)gp_stack & 0x04) { /* 8 bytes alignment */
+	if ((uintptr_t)gp_stack & 0x04) { /* 8 bytes alignment */
 		--gp_stack; 
 	}
 	
-	// Calculate beginning of heap pointers
-	beginMemMap = (U8*) p_end;
-	beginHeap = (U8*) beginMemMap + NUM_OF_MEMBLOCKS;
+	/* lay out every stack first so the pools can fill what is left */
+	for ( i = 0; i < NUM_PROCS; i++ ) {
+		U32 *sp;
+		gp_pcbs[i]->mp_sp = alloc_stack(g_proc_table[i].m_stack_size);
+		gp_pcbs[i]->mp_stack_base = gp_stack;
+		gp_pcbs[i]->m_stack_size = (U8 *)gp_pcbs[i]->mp_sp - (U8 *)gp_stack;
+		
+		/* fill the stack so its high-water mark can be measured later */
+		*gp_stack = STACK_CANARY;
+		for ( sp = gp_stack + 1; sp < gp_pcbs[i]->mp_sp; sp++ ) {
+			*sp = STACK_FILL;
+		}
+	}
+	
+	// Size each pool from its share of the free RAM, one map byte per block
+	// (4 bytes are kept back for aligning the first block)
+	free_b = ((U8 *)gp_stack > p_end + 4) ? (U8 *)gp_stack - (p_end + 4) : 0;
+	g_mem_pools[MEM_POOL_SMALL].m_blk_size = SMALL_BLOCK_SIZE;
+	g_mem_pools[MEM_POOL_SMALL].m_num_blks = (free_b / 100 * SMALL_POOL_SHARE) / (SMALL_BLOCK_SIZE + 1);
+	g_mem_pools[MEM_POOL_DEFAULT].m_blk_size = MEMORY_BLOCK_SIZE;
+	g_mem_pools[MEM_POOL_DEFAULT].m_num_blks = (free_b / 100 * DEFAULT_POOL_SHARE) / (MEMORY_BLOCK_SIZE + 1);
+	g_mem_pools[MEM_POOL_LARGE].m_blk_size = LARGE_BLOCK_SIZE;
+	g_mem_pools[MEM_POOL_LARGE].m_num_blks = (free_b / 100 * LARGE_POOL_SHARE) / (LARGE_BLOCK_SIZE + 1);
+	
+	// Carve the block pools out of the heap, maps first
+	for (i = 0; i < NUM_MEM_POOLS; i++)
+	{
+		g_mem_pools[i].mp_map = p_end;
+		p_end += g_mem_pools[i].m_num_blks;
+	}
+	p_end = (U8 *)(((uintptr_t)p_end + 3) & ~0x3); /* 4 bytes alignment */
 	
-	for (i = 0; i < NUM_OF_MEMBLOCKS; i++)
+	for (i = 0; i < NUM_MEM_POOLS; i++)
 	{
-		*(beginMemMap+i) = 0;
+		g_mem_pools[i].mp_heap = p_end;
+		p_end += g_mem_pools[i].m_num_blks * g_mem_pools[i].m_blk_size;
+		mem_pool_init(&g_mem_pools[i]);
 	}
+	
+	mem_print_layout();
 }
 
+/**
+ * Reports the pool layout and block counts on the RTX system debug terminal
+ */
+void mem_print_layout(void)
+{
+	int i;
+	char line[64];
+	uart1_put_string("\n\r----- MEMORY LAYOUT -----\n\r");
+	for (i = 0; i < NUM_MEM_POOLS; i++)
+	{
+		sprintf(line, "Pool %d: %d x %d B @ 0x%x\n\r", i, g_mem_pools[i].m_num_blks, g_mem_pools[i].m_blk_size, (U32)(uintptr_t)g_mem_pools[i].mp_heap);
+		uart1_put_string((unsigned char *)line);
+	}
+	sprintf(line, "Heap end 0x%x, stacks 0x%x..0x%x\n\r", (U32)(uintptr_t)p_end, (U32)(uintptr_t)gp_stack, RAM_END_ADDR);
+	uart1_put_string((unsigned char *)line);
+}
+
+/**
+ * Threads every block of the pool onto its free list, lowest address first
+ */
+void mem_pool_init(MEM_POOL *pool)
+{
+	int i;
+	pool->mp_free = NULL;
+	for (i = pool->m_num_blks - 1; i >= 0; i--)
+	{
+		MEM_BLK *blk = (MEM_BLK *)(pool->mp_heap + i*pool->m_blk_size);
+		*(pool->mp_map + i) = MEM_BLK_FREE;
+		blk->mp_next = pool->mp_free;
+		pool->mp_free = blk;
+	}
+	pool->m_num_free = pool->m_num_blks;
+}
 /**
  * Allocates stack for a process, align to 8 bytes boundary
  * @param: size, stack size in bytes
@@ -121,90 +177,449 @@ U32 *alloc_stack(U32 size_b)
 	gp_stack = (U32 *)((U8 *)sp - size_b);
 	
 	/* 8 bytes alignement adjustment to exception stack frame */
-	if ((U32)gp_stack & 0x04) {
+	if ((uintptr_t)gp_stack & 0x04) {
 		--gp_stack; 
 	}
 	return sp;
 }
 
 /**
- * Checks whether the memory is empty
+ * Checks whether the memory is empty for the process the kernel is acting for
+ * Blocks parked in magazines count as free, they are drained back like mem_pool_request() does
  * Returns 1 if memory is empty or 0 otherwise
  */
 int mem_empty() {
+	MEM_POOL *pool = &g_mem_pools[MEM_POOL_DEFAULT];
+	int ready_priority;
+	if (mem_pool_avail(pool, k_get_current_pid()) > 0)
+		return 0;
+	// only the UART i-process asks, so a process the drain readies waits for the next switch
+	return (mem_drain_magazines(&ready_priority) == 0 || mem_pool_avail(pool, k_get_current_pid()) == 0);
+}
+
+/**
+ * Counts the free blocks of a pool the process pid may take
+ * Only SYS_PROC processes and i-processes may take the last MEM_RESERVE_BLKS default blocks
+ */
+int mem_pool_avail(MEM_POOL *pool, U32 pid) {
+	if (pool != &g_mem_pools[MEM_POOL_DEFAULT] || gp_pcbs[pid]->m_priority == SYS_PROC)
+		return pool->m_num_free;
+	return (pool->m_num_free > MEM_RESERVE_BLKS) ? pool->m_num_free - MEM_RESERVE_BLKS : 0;
+}
+
+/**
+ * Finds the smallest pool whose blocks hold size_b bytes
+ * Returns the pool index or -1 if size_b is larger than any block
+ */
+int mem_pool_index(U32 size_b) {
 	int i;
-	for (i = 0;i < NUM_OF_MEMBLOCKS; i++)
+	for (i = 0; i < NUM_MEM_POOLS; i++)
 	{
-		if (*(beginMemMap + i) == 0)
-		{
-			return 0;
-		}
+		if (size_b <= g_mem_pools[i].m_blk_size)
+			return i;
 	}
-	return 1;
+	return -1;
 }
 
 /**
- * Requests a memory block
+ * Finds the first pool in first..last that has a free block the acting process may take
+ * Returns a pointer to the pool or NULL if they are all empty
  */
-void *k_request_memory_block(void) {
-	U8* rVoid = beginHeap;
+MEM_POOL *mem_pool_with_free(int first, int last) {
 	int i;
+	U32 pid = k_get_current_pid();
+	for (i = first; i <= last; i++)
+	{
+		if (mem_pool_avail(&g_mem_pools[i], pid) > 0)
+			return &g_mem_pools[i];
+	}
+	return NULL;
+}
+
+/**
+ * Checks whether a block of at least size_b bytes can be handed out without blocking
+ * Returns 1 if no pool large enough has a free block or 0 otherwise
+ */
+int mem_empty_sized(U32 size_b) {
+	int first = mem_pool_index(size_b);
+	if (first < 0)
+		return 1;
+	return (mem_pool_with_free(first, NUM_MEM_POOLS - 1) == NULL);
+}
+
+/**
+ * Takes a block from the first pool in first..last that has one.
+ * If they are all empty the current process blocks until a release hands it a block.
+ */
+void *mem_pool_request(int first, int last) {
+	MEM_POOL* pool;
+	MEM_BLK* blk;
+	PCB *p_pcb = k_get_current_process();
+	int ready_priority = -1;
 	__disable_irq();
-	while(mem_empty() == 1)
+	
+	// a process over its quota is parked on its own, everyone else keeps running
+	while (k_get_current_pid() == p_pcb->m_pid && p_pcb->m_mem_quota != 0 && p_pcb->m_blks_held >= p_pcb->m_mem_quota)
 	{
-		k_block_current_processs();
+		p_pcb->m_state = BLOCKED_ON_QUOTA;
 		__enable_irq();
 		k_release_processor();
 		__disable_irq();
 	}
 	
-	for (i = 0; i < NUM_OF_MEMBLOCKS; i++)
+	pool = mem_pool_with_free(first, last);
+	if (pool == NULL && first <= MEM_POOL_DEFAULT && MEM_POOL_DEFAULT <= last && mem_drain_magazines(&ready_priority) > 0)
 	{
-		if (*(beginMemMap + i) == 0)
-		{
-			*(beginMemMap + i) = 1;
-			break;
-		}
+		pool = mem_pool_with_free(MEM_POOL_DEFAULT, MEM_POOL_DEFAULT);
+	}
+	if (pool == NULL)
+	{
+		p_pcb->m_mem_first_pool = first;
+		p_pcb->m_mem_last_pool = last;
+		p_pcb->mp_mem_blk = NULL;
+		k_block_current_processs();
+		__enable_irq();
+		k_release_processor();
+		
+		// k_free_memory_block() made us the owner of the block before readying us
+		return p_pcb->mp_mem_blk;
 	}
 	
+	if (pool == &g_mem_pools[MEM_POOL_DEFAULT] && pool->m_num_free <= MEM_RESERVE_BLKS)
+		g_mem_reserve_used++;
+	blk = mem_pool_pop(pool, k_get_current_pid());
+	
 	/*#ifdef DEBUG_0 
-		printf("k_request_memory_block: @ 0x%x\n\r", rVoid+i*MEMORY_BLOCK_SIZE);
+		printf("k_request_memory_block: @ 0x%x\n\r", blk);
 	#endif */
 	__enable_irq();
-	return (void*) (rVoid+i*MEMORY_BLOCK_SIZE);
+	// draining the magazines may have readied a process parked on its quota
+	if (ready_priority != -1 && g_iproc_pid == -1 && PRIO_LEVEL(ready_priority) < PRIO_LEVEL(p_pcb->m_priority))
+		k_release_processor();
+	return (void*) blk;
 }
 
-int k_non_block_release_memory_block(void *p_mem_blk)
-{
-	int index;
-	int ready_priority;
+/**
+ * Returns the blocks held in every process's magazine to the default pool
+ * Returns the number of blocks returned
+ * The highest priority of the processes it readied (or -1 if none) is stored in p_ready_priority
+ * PRE: interrupts are disabled
+ */
+int mem_drain_magazines(int *p_ready_priority) {
+	int i;
+	int count = 0;
+	MEM_POOL *pool = &g_mem_pools[MEM_POOL_DEFAULT];
+	*p_ready_priority = -1;
+	for (i = 0; i < NUM_PROCS; i++)
+	{
+		PCB *p_pcb = gp_pcbs[i];
+		while (p_pcb->m_mag_count > 0)
+		{
+			void *blk = p_pcb->mp_magazine[--p_pcb->m_mag_count];
+			*MEM_MAP_ENTRY(pool, blk) = p_pcb->m_pid;
+			mem_note_ready(p_ready_priority, mem_pool_push(pool, (MEM_BLK *)blk));
+			count++;
+		}
+	}
+	return count;
+}
+
+/**
+ * Requests a memory block of MEMORY_BLOCK_SIZE bytes from the calling process's magazine.
+ * Runs in thread mode and only traps into the kernel when the magazine is empty.
+ */
+void *cached_request_memory_block(void) {
+	PCB *p_pcb = k_get_current_process();
+	void *blk = NULL;
 	__disable_irq();
+	if (p_pcb->m_mag_count > 0){
+		blk = p_pcb->mp_magazine[--p_pcb->m_mag_count];
+		*MEM_MAP_ENTRY(&g_mem_pools[MEM_POOL_DEFAULT], blk) = p_pcb->m_pid;
+		((ENVELOPE *)blk)->msg_prio = MSG_PRIO_NORMAL;
+	}
+	__enable_irq();
+	if (blk == NULL)
+		blk = request_memory_block();
+	return blk;
+}
+
+/**
+ * Keeps a released MEMORY_BLOCK_SIZE block in the calling process's magazine.
+ * Traps into the kernel when the magazine is full, the block is not an allocated
+ * default block or a process is blocked on memory and should get it instead.
+ */
+int cached_release_memory_block(void *p_mem_blk) {
+	PCB *p_pcb = k_get_current_process();
+	MEM_POOL *pool = &g_mem_pools[MEM_POOL_DEFAULT];
+	__disable_irq();
+	// a block already in the magazine is marked MEM_BLK_CACHED, so releasing it again fails below
+	if (p_pcb->m_mag_count < MEM_MAGAZINE_SIZE && prio_empty(&blocked_on_memory_queue)
+		&& mem_pool_of(p_mem_blk) == pool && *MEM_MAP_ENTRY(pool, p_mem_blk) == p_pcb->m_pid)
+	{
+		*MEM_MAP_ENTRY(pool, p_mem_blk) = MEM_BLK_CACHED;
+		p_pcb->mp_magazine[p_pcb->m_mag_count++] = p_mem_blk;
+		__enable_irq();
+		return RTX_OK;
+	}
+	__enable_irq();
+	return release_memory_block(p_mem_blk);
+}
+
+/**
+ * Requests a memory block of MEMORY_BLOCK_SIZE bytes
+ */
+void *k_request_memory_block(void) {
+	return mem_pool_request(MEM_POOL_DEFAULT, MEM_POOL_DEFAULT);
+}
+
+/**
+ * Requests a memory block of at least size_b bytes from the smallest size class that has one
+ * Returns NULL if size_b is larger than LARGE_BLOCK_SIZE
+ */
+void *k_request_memory_block_sized(U32 size_b) {
+	int first = mem_pool_index(size_b);
+	if (first < 0)
+		return NULL;
+	return mem_pool_request(first, NUM_MEM_POOLS - 1);
+}
+
+/**
+ * Finds the pool a block belongs to
+ * Returns a pointer to the pool or NULL if the address is not the start of a block
+ */
+MEM_POOL *mem_pool_of(void *p_mem_blk) {
+	int i;
+	for (i = 0; i < NUM_MEM_POOLS; i++)
+	{
+		MEM_POOL *pool = &g_mem_pools[i];
+		if (((U8*) p_mem_blk >= pool->mp_heap)&&((U8*) p_mem_blk < pool->mp_heap + pool->m_num_blks*pool->m_blk_size))
+		{
+			if (((U8*)p_mem_blk - pool->mp_heap)%pool->m_blk_size != 0)
+				return NULL;
+			return pool;
+		}
+	}
+	return NULL;
+}
+
+/**
+ * Takes the first block off the free list of the pool and records pid as its owner
+ * PRE: interrupts are disabled and the pool has a free block
+ */
+MEM_BLK *mem_pool_pop(MEM_POOL *pool, U32 pid) {
+	MEM_BLK *blk = pool->mp_free;
+	pool->mp_free = blk->mp_next;
+	pool->m_num_free--;
+	*MEM_MAP_ENTRY(pool, blk) = pid;
+	gp_pcbs[pid]->m_blks_held++;
+	((ENVELOPE *)blk)->msg_prio = MSG_PRIO_NORMAL;
+	return blk;
+}
+
+/**
+ * Puts an allocated block back on the free list of its pool
+ * Returns the priority of the process readied by mem_drop_held() or -1 if none
+ * PRE: interrupts are disabled
+ */
+int mem_pool_push(MEM_POOL *pool, MEM_BLK *blk) {
+	U8 *owner = MEM_MAP_ENTRY(pool, blk);
+	int ready_priority = mem_drop_held(gp_pcbs[*owner]);
+	*owner = MEM_BLK_FREE;
+	blk->mp_next = pool->mp_free;
+	pool->mp_free = blk;
+	pool->m_num_free++;
+	return ready_priority;
+}
+
+/**
+ * Takes one block off the count held by a process, readying it if that
+ * brings it back under a quota it was parked on
+ * Returns the priority of the readied process or -1 if it stays as it is
+ * PRE: interrupts are disabled
+ */
+int mem_drop_held(PCB *p_pcb) {
+	p_pcb->m_blks_held--;
+	if (p_pcb->m_state != BLOCKED_ON_QUOTA || p_pcb->m_blks_held >= p_pcb->m_mem_quota)
+		return -1;
+	k_ready_process(p_pcb->m_pid);
+	return p_pcb->m_priority;
+}
+
+/**
+ * Keeps the higher of the priority stored in p_ready_priority (-1 if none) and priority
+ */
+void mem_note_ready(int *p_ready_priority, int priority) {
+	if (priority != -1 && (*p_ready_priority == -1 || PRIO_LEVEL(priority) < PRIO_LEVEL(*p_ready_priority)))
+		*p_ready_priority = priority;
+}
+
+/**
+ * Transfers the ownership of an allocated block to the process pid
+ * Blocks that are not from a pool (e.g. kernel-built envelopes) are ignored
+ */
+void mem_set_owner(void *p_mem_blk, U32 pid) {
+	MEM_POOL *pool = mem_pool_of(p_mem_blk);
+	U8 *owner;
+	if (pool == NULL)
+		return;
+	owner = MEM_MAP_ENTRY(pool, p_mem_blk);
+	if (*owner == MEM_BLK_FREE || *owner == MEM_BLK_SHARED || *owner == MEM_BLK_CACHED || *owner == pid)
+		return;
+	mem_drop_held(gp_pcbs[*owner]);
+	gp_pcbs[pid]->m_blks_held++;
+	*owner = pid;
+}
+
+/**
+ * Checks whether a pool block is allocated to the process pid, free blocks, blocks
+ * parked in a magazine, multicast envelopes and addresses outside the pools are not
+ * Returns 1 if pid owns the block or 0 otherwise
+ */
+int mem_is_owner(void *p_mem_blk, U32 pid) {
+	MEM_POOL *pool = mem_pool_of(p_mem_blk);
+	if (pool == NULL)
+		return 0;
+	// the MEM_BLK_ markers are above every PID, so they never match
+	return (*MEM_MAP_ENTRY(pool, p_mem_blk) == pid);
+}
+
+/**
+ * Marks an allocated envelope as shared by the receivers of a multicast,
+ * it is charged to no process until the last of them releases it
+ */
+void mem_set_shared(void *p_mem_blk) {
+	MEM_POOL *pool = mem_pool_of(p_mem_blk);
+	U8 *owner;
+	if (pool == NULL)
+		return;
+	owner = MEM_MAP_ENTRY(pool, p_mem_blk);
+	if (*owner == MEM_BLK_FREE || *owner == MEM_BLK_SHARED || *owner == MEM_BLK_CACHED)
+		return;
+	mem_drop_held(gp_pcbs[*owner]);
+	*owner = MEM_BLK_SHARED;
+}
+
+/**
+ * Puts a memory block back on its free list and hands it on to the highest priority process
+ * blocked on memory that accepts it, if that process may take a block the pool has left
+ * Only the owner of a block may release it, each receiver of a multicast envelope may release it once,
+ * send_signal() envelopes go back to their own pool
+ * Returns -1 if the block is invalid, already free, parked in a magazine, owned by another process
+ * or a multicast envelope the caller does not hold, 0 otherwise
+ * The highest priority of the processes it readied (or -1 if none) is stored in p_ready_priority
+ */
+int k_free_memory_block(void *p_mem_blk, int *p_ready_priority)
+{
+	U8 *owner;
+	MEM_POOL *pool;
+	PCB *waiter;
+	int signal;
+	*p_ready_priority = -1;
 	if (p_mem_blk == NULL){
 		return RTX_ERR;
 	}
 	
-	if (((U8*) p_mem_blk < beginHeap)||((U8*)p_mem_blk + MEMORY_BLOCK_SIZE > (beginHeap+NUM_OF_MEMBLOCKS*MEMORY_BLOCK_SIZE))){ 
+	__disable_irq();
+	signal = msg_signal_free(p_mem_blk);
+	__enable_irq();
+	if (signal != 0){
+		// a send_signal() envelope, only the process that received it may release it
+		return (signal == 1) ? RTX_OK : RTX_ERR;
+	}
+	
+	pool = mem_pool_of(p_mem_blk);
+	if (pool == NULL){
 		return RTX_ERR;
 	}
 	
-	if (((U8*)p_mem_blk - beginHeap)%MEMORY_BLOCK_SIZE != 0){
+	__disable_irq();
+	owner = MEM_MAP_ENTRY(pool, p_mem_blk);
+	if (*owner == MEM_BLK_SHARED){
+		// a multicast envelope, each receiver releases it once and the last one frees it
+		ENVELOPE *env = (ENVELOPE *)p_mem_blk;
+		U16 bit = 1 << k_get_current_pid();
+		if (!(env->pending_pids & bit)){
+			__enable_irq();
+			return RTX_ERR;
+		}
+		env->pending_pids &= ~bit;
+		if (--env->ref_count > 0){
+			__enable_irq();
+			return RTX_OK;
+		}
+		*owner = k_get_current_pid();
+		gp_pcbs[*owner]->m_blks_held++;
+	}
+	if (!mem_is_owner(p_mem_blk, k_get_current_pid())){
+		// double free, still parked in a magazine or not the owner
+		__enable_irq();
 		return RTX_ERR;
 	}
 	
-	index = ((U8*)p_mem_blk - beginHeap)/MEMORY_BLOCK_SIZE;
-	*(beginMemMap + index) = 0;
-	ready_priority = k_ready_first_blocked();
+	*p_ready_priority = mem_pool_push(pool, (MEM_BLK *)p_mem_blk);
+	
+	// the waiter only gets the block if it could have taken it itself, so a
+	// reserve block released by a system process is not handed to a user process
+	waiter = k_find_blocked_on_memory(pool - g_mem_pools);
+	if (waiter != NULL && mem_pool_avail(pool, waiter->m_pid) > 0){
+		if (pool == &g_mem_pools[MEM_POOL_DEFAULT] && pool->m_num_free <= MEM_RESERVE_BLKS)
+			g_mem_reserve_used++;
+		waiter->mp_mem_blk = mem_pool_pop(pool, waiter->m_pid);
+		k_ready_blocked_on_memory(waiter);
+		mem_note_ready(p_ready_priority, waiter->m_priority);
+	}
 	__enable_irq();
-	return ready_priority;
+	return RTX_OK;
+}
+
+int k_non_block_release_memory_block(void *p_mem_blk)
+{
+	int ready_priority;
+	return k_free_memory_block(p_mem_blk, &ready_priority);
 }
 
 /**
  * Releases a memory block
+ * Yields only if the release readied a process that outranks the caller
  */
 int k_release_memory_block(void *p_mem_blk) {
 	int ready_priority;
-	ready_priority = k_non_block_release_memory_block(p_mem_blk);
-	if (ready_priority != k_get_current_process()->m_priority)
+	if (k_free_memory_block(p_mem_blk, &ready_priority) != RTX_OK)
+		return RTX_ERR;
+	if (ready_priority != -1 && PRIO_LEVEL(ready_priority) < PRIO_LEVEL(k_get_current_process()->m_priority))
 		k_release_processor();
 	return RTX_OK;
 }
+
+// HotKey #5: printing to the RTX system debug terminal the blocks held by every process
+void k_print_blocks_held()
+{
+	int i, j, pid;
+	char line[48];
+	uart1_put_string("\n\r\n\r----- MEMORY BLOCKS HELD PER PROCESS -----\n\r");
+	sprintf(line, "\n\rReserve blocks taken: %d\n\r", g_mem_reserve_used);
+	uart1_put_string((unsigned char *)line);
+	sprintf(line, "Console input dropped: %d\n\r", g_input_dropped);
+	uart1_put_string((unsigned char *)line);
+	
+	for (pid = 0; pid < NUM_PROCS; pid++){
+		if (gp_pcbs[pid]->m_blks_held == 0)
+			continue;
+		sprintf(line, "\n\rProcess with PID %d holds %d", pid, gp_pcbs[pid]->m_blks_held);
+		uart1_put_string((unsigned char *)line);
+		if (gp_pcbs[pid]->m_mem_quota != 0){
+			sprintf(line, " (quota %d)", gp_pcbs[pid]->m_mem_quota);
+			uart1_put_string((unsigned char *)line);
+		}
+		uart1_put_string(":\n\r");
+		
+		for (i = 0; i < NUM_MEM_POOLS; i++){
+			for (j = 0; j < g_mem_pools[i].m_num_blks; j++){
+				if (*(g_mem_pools[i].mp_map + j) == pid){
+					sprintf(line, "\t %d B block @ 0x%x\n\r", g_mem_pools[i].m_blk_size, (U32)(uintptr_t)(g_mem_pools[i].mp_heap + j*g_mem_pools[i].m_blk_size));
+					uart1_put_string((unsigned char *)line);
+				}
+			}
+		}
+	}
+}
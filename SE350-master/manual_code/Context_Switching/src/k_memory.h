@@ -11,23 +11,87 @@
 #include "k_rtx.h"
 
 /* ----- Definitions ----- */
-#define MEMORY_BLOCK_SIZE 128
-#define NUM_OF_MEMBLOCKS 32
 #define RAM_END_ADDR 0x10008000
 
+/* Size classes, ordered from the smallest block to the largest */
+#define NUM_MEM_POOLS 3
+#define MEM_POOL_SMALL 0
+#define MEM_POOL_DEFAULT 1	/* the pool request_memory_block() draws from */
+#define MEM_POOL_LARGE 2
+
+#define SMALL_BLOCK_SIZE 32
+#define MEMORY_BLOCK_SIZE 128
+#define LARGE_BLOCK_SIZE 512
+
+/* Share of the RAM left after the PCBs and stacks given to each pool, in percent */
+#define SMALL_POOL_SHARE 10
+#define DEFAULT_POOL_SHARE 65
+#define LARGE_POOL_SHARE 25
+
+/* Default blocks kept back for SYS_PROC processes and i-processes */
+#ifndef MEM_RESERVE_BLKS
+	#define MEM_RESERVE_BLKS 4
+#endif
+
+#define MEM_BLK_FREE 0xFF	/* map entry of a free block, otherwise it holds the owner's PID */
+#define MEM_BLK_SHARED 0xFE	/* map entry of a multicast envelope, freed by its last receiver */
+#define MEM_BLK_CACHED 0xFD	/* map entry of a block parked in a magazine, still charged to that process */
+
+/* map entry of the block blk in pool */
+#define MEM_MAP_ENTRY(pool, blk) ((pool)->mp_map + ((U8*)(blk) - (pool)->mp_heap)/(pool)->m_blk_size)
+
+/* ----- Types ----- */
+/* A free block holds the link to the next free block in its first word */
+typedef struct mem_blk
+{
+	struct mem_blk *mp_next;
+} MEM_BLK;
+
+/* A pool of equally sized blocks */
+typedef struct mem_pool
+{
+	U32 m_blk_size;		/* size of each block in bytes */
+	U32 m_num_blks;		/* number of blocks in the pool */
+	U32 m_num_free;		/* number of blocks on the free list */
+	U8 *mp_heap;			/* first block of the pool */
+	U8 *mp_map;				/* one byte per block, a MEM_BLK_ marker or the owner's PID */
+	MEM_BLK *mp_free;	/* free blocks, linked through their first word */
+} MEM_POOL;
+
 /* ----- Variables ----- */
 /* This symbol is defined in the scatter file (see RVCT Linker User Guide) */  
 extern unsigned int Image$$RW_IRAM1$$ZI$$Limit; 
 extern PCB **gp_pcbs;
-extern PCB_NODE **gp_pcb_nodes;
 extern PROC_INIT g_proc_table[NUM_PROCS];
 
 /* ----- Functions ------ */
 int mem_empty(void);
+int mem_empty_sized(U32 size_b);
 void memory_init(void);
+void mem_pool_init(MEM_POOL *pool);
+void mem_print_layout(void);
+int mem_pool_index(U32 size_b);
+int mem_pool_avail(MEM_POOL *pool, U32 pid);
+MEM_POOL *mem_pool_with_free(int first, int last);
+MEM_POOL *mem_pool_of(void *p_mem_blk);
+MEM_BLK *mem_pool_pop(MEM_POOL *pool, U32 pid);
+int mem_pool_push(MEM_POOL *pool, MEM_BLK *blk);
+int mem_drop_held(PCB *p_pcb);
+void mem_note_ready(int *p_ready_priority, int priority);
+void mem_set_owner(void *p_mem_blk, U32 pid);
+int mem_is_owner(void *p_mem_blk, U32 pid);
+void mem_set_shared(void *p_mem_blk);
+void *mem_pool_request(int first, int last);
+int mem_drain_magazines(int *p_ready_priority);
 U32 *alloc_stack(U32 size_b);
 void *k_request_memory_block(void);
+void *k_request_memory_block_sized(U32 size_b);
 int k_release_memory_block(void *);
 int k_non_block_release_memory_block(void *p_mem_blk);
+int k_free_memory_block(void *p_mem_blk, int *p_ready_priority);
+
+#ifdef DEBUG_HOTKEYS
+	void k_print_blocks_held(void);
+#endif
 
 #endif /* ! K_MEM_H_ */
@@ -5,7 +5,8 @@
  * @author: Yiqing Huang and Thomas Reidemeister
  * @date:   2014/01/17
  * NOTE: Implementing context switching.
- *       The code only has minimal sanity check. There is no stack overflow check.
+ *       The code only has minimal sanity check. Stack overflow is caught by a canary
+ *       at the bottom of each stack, checked on every process switch.
  *       The implementation assumes six user processes and NO HARDWARE INTERRUPTS.
  */
 
@@ -15,22 +16,23 @@
 #include "k_process.h"
 #include "k_sys_proc.h"
 #include "k_usr_proc.h"
+#include "printf.h"
 
 /* ----- Global Variables ----- */
 PCB **gp_pcbs = NULL; //array of pcb pointers
-PCB_NODE **gp_pcb_nodes = NULL;  // actual pcb node array
 PCB *gp_current_process = NULL; // always point to the current RUN process
 
 /* Process Initialization Table */
 PROC_INIT g_proc_table[NUM_PROCS];
 int uart_preemption_flag = 0;
+int g_iproc_pid = -1; // PID of the i-process being run, -1 outside of i-processes
 
 extern PROC_INIT g_test_procs[NUM_TEST_PROCS];
 
 /* ----- Queue Declarations ----- */
-QUEUE ready_priority_queue[6];
-QUEUE blocked_on_memory_queue[6];
-PCB_NODE* blocked_on_receive_list = NULL;
+PRIO_QUEUE ready_priority_queue;
+PRIO_QUEUE blocked_on_memory_queue;
+PRIO_QUEUE blocked_on_receive_queue;
 
 KC_LIST g_kc_reg[KC_MAX_COMMANDS];
 /**
@@ -38,22 +40,19 @@ KC_LIST g_kc_reg[KC_MAX_COMMANDS];
  * Returns the process priority value or -1 if it does not find a process with the provide process ID
  */
 int k_get_process_priority(int process_id){
-	PCB_NODE *node = gp_pcb_nodes[process_id];
-	if (node == NULL){
+	if (process_id < 0 || process_id >= NUM_PROCS){
 		return RTX_ERR;
 	}
-	return node->p_pcb->m_priority;
+	return gp_pcbs[process_id]->m_priority;
 }
 	
 /**
- * Initialize all processes in the system
+ * Fill out the initialization table for all processes in the system
  */
-void process_init() 
+void set_proc_table() 
 {
 	int i;
-	U32 *sp;
 	
-  /* Fill out the initialization table */
 	set_test_procs();
 	
 	// Setting the Null Process in the initialization table
@@ -73,12 +72,14 @@ void process_init()
 	g_proc_table[8].m_priority = HIGH;
 	g_proc_table[8].mpf_start_pc = &stress_test_b;
 	g_proc_table[8].m_stack_size = 0x100;
+	g_proc_table[8].m_mbox_limit = 8;
 	
 	// Setting the stress_test_c Process in the initialization table
 	g_proc_table[9].m_pid = 9;
 	g_proc_table[9].m_priority = HIGH;
 	g_proc_table[9].mpf_start_pc = &stress_test_c;
 	g_proc_table[9].m_stack_size = 0x100;
+	g_proc_table[9].m_mbox_limit = 8;
 	
 	// Setting the set_priority_proc Process in the initialization table
 	g_proc_table[10].m_pid = 10;
@@ -122,7 +123,19 @@ void process_init()
 		g_proc_table[i].m_priority = g_test_procs[i-1].m_priority;
 		g_proc_table[i].m_stack_size = g_test_procs[i-1].m_stack_size;
 		g_proc_table[i].mpf_start_pc = g_test_procs[i-1].mpf_start_pc;
+		g_proc_table[i].m_mem_quota = g_test_procs[i-1].m_mem_quota;
+		g_proc_table[i].m_mbox_limit = g_test_procs[i-1].m_mbox_limit;
 	}
+}
+
+/**
+ * Initialize all processes in the system
+ * PRE: memory_init() has allocated every stack and left its top in mp_sp
+ */
+void process_init() 
+{
+	int i;
+	U32 *sp;
   
 	// initilize exception stack frame (i.e. initial context) for each process
 	for ( i = 0; i < NUM_PROCS; i++ ) {
@@ -132,40 +145,46 @@ void process_init()
 		(gp_pcbs[i])->m_priority = (g_proc_table[i]).m_priority;
 		
 		// Message queue init
-		(gp_pcbs[i])->env_q.head = NULL;
-		(gp_pcbs[i])->env_q.tail = NULL;
+		msg_queue_init(&((gp_pcbs[i])->env_q));
+		(gp_pcbs[i])->m_mbox_limit = (g_proc_table[i]).m_mbox_limit;
+		(gp_pcbs[i])->m_senders.head = NULL;
+		(gp_pcbs[i])->m_senders.tail = NULL;
 		
-		sp = alloc_stack((g_proc_table[i]).m_stack_size);
+		sp = (gp_pcbs[i])->mp_sp;
 		*(--sp)  = INITIAL_xPSR; // user process initial xPSR  
-		*(--sp)  = (U32)((g_proc_table[i]).mpf_start_pc); // PC contains the entry point of the process
+		*(--sp)  = (U32)(uintptr_t)((g_proc_table[i]).mpf_start_pc); // PC contains the entry point of the process
 		for ( j = 0; j < 6; j++ ) { // R0-R3, R12 are cleared with 0
 			*(--sp) = 0x0;
 		}
 		(gp_pcbs[i])->mp_sp = sp;
 		
-		(gp_pcb_nodes[i])->next = NULL;
-		(gp_pcb_nodes[i])->p_pcb = gp_pcbs[i];
+		(gp_pcbs[i])->mp_next = NULL;
+		(gp_pcbs[i])->mp_prev = NULL;
+		(gp_pcbs[i])->mp_mem_blk = NULL;
+		(gp_pcbs[i])->m_mag_count = 0;
+		(gp_pcbs[i])->m_blks_held = 0;
+		(gp_pcbs[i])->m_mem_quota = (g_proc_table[i]).m_mem_quota;
+		(gp_pcbs[i])->m_rcv_type_mask = MSG_TYPE_ANY;
+		(gp_pcbs[i])->m_rcv_sender = MSG_SENDER_ANY;
+		(gp_pcbs[i])->m_timer.mp_next = NULL;
+		(gp_pcbs[i])->m_timer.mp_env = NULL;
+		(gp_pcbs[i])->m_timer.mp_pcb = gp_pcbs[i];
+		(gp_pcbs[i])->m_timer_expired = 0;
 	}
 	
 	// Setting all ready queues to be empty
-	for (i = 0; i < 6; i++){
-		ready_priority_queue[i].head = NULL;
-		ready_priority_queue[i].tail = NULL;
-	}
+	prio_init(&ready_priority_queue);
 	
 	// Adding the processes to the appropriate ready queue
 	for (i = 0; i <= 13; i++) {
-		enqueue(&(ready_priority_queue[(gp_pcbs[i])->m_priority]), gp_pcb_nodes[i]);
+		prio_enqueue(&ready_priority_queue, gp_pcbs[i]);
 	}
 
-	// Setting everything in the blocked queue to be null
-	blocked_on_receive_list = NULL;
+	// Setting the blocked on receive queues to be empty
+	prio_init(&blocked_on_receive_queue);
 	
 	// Setting blocked on memory queues to be empty
-	for (i = 0; i < 6; i++){
-		blocked_on_memory_queue[i].head = NULL;
-		blocked_on_memory_queue[i].tail = NULL;
-	}
+	prio_init(&blocked_on_memory_queue);
 	
 	// Keyboard commands initialization
 	for (i = 0; i < KC_MAX_COMMANDS; i++)
@@ -176,10 +195,11 @@ void process_init()
 }
 
 /**
- * Enqueues the provided PCB node in the given queue
+ * Enqueues the provided PCB in the given queue
  */
-void enqueue(QUEUE *q, PCB_NODE *n) {
-	n->next = NULL;
+void enqueue(QUEUE *q, PCB *n) {
+	n->mp_next = NULL;
+	n->mp_prev = q->tail;
 	if (q->head == NULL)
 	{
 		q->head = n;
@@ -187,69 +207,56 @@ void enqueue(QUEUE *q, PCB_NODE *n) {
 	}
 	else
 	{
-		q->tail->next = n;
-		q->tail = q->tail->next;
+		q->tail->mp_next = n;
+		q->tail = n;
 	}
 }
 
 /**
  * Dequeues the head of the queue
- * Returns a pointer to the dequeued PCB node
+ * Returns a pointer to the dequeued PCB
  */
-PCB_NODE* dequeue(QUEUE *q) {
-	PCB_NODE *curHead = q->head;
-	if (q->head == q->tail)
-	{
-		q->head = NULL;
+PCB* dequeue(QUEUE *q) {
+	PCB *curHead = q->head;
+	q->head = curHead->mp_next;
+	if (q->head == NULL)
 		q->tail = NULL;
-	}
 	else
-		q->head = q->head->next;
-	curHead->next = NULL;
+		q->head->mp_prev = NULL;
+	curHead->mp_next = NULL;
 	return curHead;
 }
 
 /**
  * Peeks at the head of the queue
- * Returns a pointer to the PCB node
+ * Returns a pointer to the PCB
  */
-PCB_NODE* peek(QUEUE *q) {
+PCB* peek(QUEUE *q) {
 	return q->head;
 }
 
 /**
- * Removes the provided PCB node in the given queue
- * Returns -1 or 0 corresponding to failure or success in removal
+ * Unlinks the provided PCB from the given queue using its own links
+ * Returns -1 if the PCB is not linked into the queue or 0 upon success
  */
-int remove (QUEUE *q, PCB_NODE * n){
-	if (q->head == n){
-		if (q->head == q->tail){
-			q->tail = NULL;	
-		}
-		q->head = n->next;
-		return RTX_OK;
-	}
-	else {
-		PCB_NODE * prev = q->head;
-		PCB_NODE * cur = q->head->next;
-		while (cur  != NULL){
-			if (cur == n){
-				/* our changes */
-				if(cur->next == NULL){
-					q->tail = prev;
-				}
-				/*****/
-				prev->next = cur->next;
-				cur->next = NULL;
-				return RTX_OK;
-			}
-			else {
-				cur = cur->next;
-				prev = prev->next;
-			}
-		}
+int remove (QUEUE *q, PCB *n){
+	if (n->mp_prev == NULL && q->head != n){
+		return RTX_ERR;
 	}
-	return RTX_ERR;
+	
+	if (n->mp_prev == NULL)
+		q->head = n->mp_next;
+	else
+		n->mp_prev->mp_next = n->mp_next;
+	
+	if (n->mp_next == NULL)
+		q->tail = n->mp_prev;
+	else
+		n->mp_next->mp_prev = n->mp_prev;
+	
+	n->mp_next = NULL;
+	n->mp_prev = NULL;
+	return RTX_OK;
 }
 
 /**
@@ -260,27 +267,104 @@ int isEmpty(QUEUE *q) {
 	return (q->head == NULL);
 }
 
+/**
+ * Empties every level of the priority queue
+ */
+void prio_init(PRIO_QUEUE *pq) {
+	int i;
+	pq->bitmap = 0;
+	for (i = 0; i < NUM_PRIORITY_LEVELS; i++){
+		pq->level[i].head = NULL;
+		pq->level[i].tail = NULL;
+	}
+}
+
+/**
+ * Enqueues the provided PCB at the level of its process priority
+ */
+void prio_enqueue(PRIO_QUEUE *pq, PCB *n) {
+	int level = PRIO_LEVEL(n->m_priority);
+	enqueue(&(pq->level[level]), n);
+	pq->bitmap |= (0x80000000 >> level);
+}
+
+/**
+ * Dequeues the head of the highest non-empty level
+ * Returns a pointer to the dequeued PCB or NULL if all levels are empty
+ */
+PCB* prio_dequeue(PRIO_QUEUE *pq) {
+	int level;
+	PCB *n;
+	if (pq->bitmap == 0){
+		return NULL;
+	}
+	level = __clz(pq->bitmap);
+	n = dequeue(&(pq->level[level]));
+	if (isEmpty(&(pq->level[level]))){
+		pq->bitmap &= ~(0x80000000 >> level);
+	}
+	return n;
+}
+
+/**
+ * Removes the provided PCB from the level of its process priority
+ * Returns -1 or 0 corresponding to failure or success in removal
+ */
+int prio_remove(PRIO_QUEUE *pq, PCB *n) {
+	int level = PRIO_LEVEL(n->m_priority);
+	if (remove(&(pq->level[level]), n) != RTX_OK){
+		return RTX_ERR;
+	}
+	if (isEmpty(&(pq->level[level]))){
+		pq->bitmap &= ~(0x80000000 >> level);
+	}
+	return RTX_OK;
+}
+
+/**
+ * Checks whether every level of the priority queue is empty
+ * Returns 1 if the priority queue is empty or 0 otherwise
+ */
+int prio_empty(PRIO_QUEUE *pq) {
+	return (pq->bitmap == 0);
+}
+
 /**
  * Sets the process priority
  * Returns -1 if it fails or 0 otherwise
  */
 int k_set_process_priority(int process_id, int priority){
-	PCB_NODE * node = NULL;
-	if (process_id < 1 || process_id > NUM_TEST_PROCS || priority < 0 || priority > 3){
+	PCB * pcb = NULL;
+	if (process_id < 1 || process_id > NUM_TEST_PROCS || priority < HIGH || priority > LOWEST){
 		return RTX_ERR;
 	}
-	node = gp_pcb_nodes[process_id];
+	pcb = gp_pcbs[process_id];
 	
-	if(node->p_pcb->m_priority != priority){
-		if (node->p_pcb->m_state != BLOCKED_ON_MEMORY && node->p_pcb != gp_current_process){
-			if (remove(&ready_priority_queue[node->p_pcb->m_priority], node) != RTX_OK){
+	if(pcb->m_priority != priority){
+		// Move the process to its new level in whichever queue it is on
+		if ((pcb->m_state == RDY || pcb->m_state == NEW) && pcb != gp_current_process){
+			if (prio_remove(&ready_priority_queue, pcb) != RTX_OK){
+				return RTX_ERR;
+			}
+			pcb->m_priority = priority;
+			prio_enqueue(&ready_priority_queue, pcb);
+		}
+		else if (pcb->m_state == BLOCKED_ON_MEMORY){
+			if (prio_remove(&blocked_on_memory_queue, pcb) != RTX_OK){
+				return RTX_ERR;
+			}
+			pcb->m_priority = priority;
+			prio_enqueue(&blocked_on_memory_queue, pcb);
+		}
+		else if (pcb->m_state == BLOCKED_ON_RECEIVE){
+			if (prio_remove(&blocked_on_receive_queue, pcb) != RTX_OK){
 				return RTX_ERR;
 			}
-			node->p_pcb->m_priority = priority;
-			enqueue(&ready_priority_queue[node->p_pcb->m_priority], node);
+			pcb->m_priority = priority;
+			prio_enqueue(&blocked_on_receive_queue, pcb);
 		}
 
-		node->p_pcb->m_priority = priority;
+		pcb->m_priority = priority;
 		//uart0_put_string("priority set\n\r");
 		k_release_processor();
 	}
@@ -295,25 +379,17 @@ int k_set_process_priority(int process_id, int priority){
  */
 PCB *scheduler(void)
 {
-	int i = 0;
 	if (uart_preemption_flag == 1){
 		uart_preemption_flag = 0;
 		return gp_pcbs[UART_IPROC_PID];
 	}
-	// Checks if there are any system processes ready to run
-	if(!isEmpty(&ready_priority_queue[SYS_PROC])){
-		// Returns any system processes first
-		return dequeue(&ready_priority_queue[SYS_PROC])->p_pcb;
-	}
 	
-	// Then checks the user procs (last/default is null process)
-	for (i = 0; i < 5; i++){
-		if(!isEmpty(&ready_priority_queue[i])){
-			// Returns the PCB of the highest priority
-			return dequeue(&ready_priority_queue[i])->p_pcb;
-		}
+	// System processes sit on level 0 so they are returned first,
+	// then the user procs (last/default is null process)
+	if(prio_empty(&ready_priority_queue)){
+		return NULL;
 	}
-	return NULL;
+	return prio_dequeue(&ready_priority_queue);
 }
 
 /**
@@ -325,13 +401,17 @@ int process_switch(PCB *p_pcb_old)
 {
 	PROC_STATE_E state = gp_current_process->m_state;
 	
+	if (*(p_pcb_old->mp_stack_base) != STACK_CANARY) {
+		k_stack_overflow(p_pcb_old);
+	}
+	
 	if (state == NEW) {
 		if (gp_current_process != p_pcb_old && p_pcb_old->m_state != NEW) {
 			//p_pcb_old->m_state = RDY;
 			p_pcb_old->mp_sp = (U32 *) __get_MSP();
 		}
 		gp_current_process->m_state = RUN;
-		__set_MSP((U32) gp_current_process->mp_sp);
+		__set_MSP((U32)(uintptr_t) gp_current_process->mp_sp);
 		__rte(); // pop exception stack frame from the stack for a new processes
 	} 
 	
@@ -342,7 +422,7 @@ int process_switch(PCB *p_pcb_old)
 			//p_pcb_old->m_state = RDY; 
 			p_pcb_old->mp_sp = (U32 *) __get_MSP(); // save the old process's sp
 			gp_current_process->m_state = RUN;
-			__set_MSP((U32) gp_current_process->mp_sp); //switch to the new proc's stack    
+			__set_MSP((U32)(uintptr_t) gp_current_process->mp_sp); //switch to the new proc's stack    
 		} else {
 			gp_current_process = p_pcb_old; // revert back to the old proc on error
 			return RTX_ERR;
@@ -355,6 +435,40 @@ int process_switch(PCB *p_pcb_old)
 	return RTX_OK;
 }
 
+/**
+ * Reports a process whose stack ran over its canary and halts the system
+ */
+void k_stack_overflow(PCB *p_pcb)
+{
+	char line[48];
+	__disable_irq();
+	sprintf(line, "\n\rStack overflow in process with PID %d\n\r", p_pcb->m_pid);
+	uart1_put_string((unsigned char *)line);
+	while (1) {
+	}
+}
+
+/**
+ * Gets the deepest stack use of a process so far
+ * Returns the number of bytes used or -1 if there is no process with the provided process ID
+ */
+int k_get_stack_high_water(int process_id)
+{
+	PCB *pcb;
+	U32 *sp;
+	U32 *top;
+	if (process_id < 0 || process_id >= NUM_PROCS){
+		return RTX_ERR;
+	}
+	pcb = gp_pcbs[process_id];
+	top = (U32 *)((U8 *)pcb->mp_stack_base + pcb->m_stack_size);
+	
+	// the stack grows down, so the lowest word not holding the fill pattern is the deepest one used
+	for (sp = pcb->mp_stack_base + 1; sp < top && *sp == STACK_FILL; sp++) {
+	}
+	return (U8 *)top - (U8 *)sp;
+}
+
 /**
  * Releases the processor
  * Returns -1 on error or 0 on success
@@ -371,7 +485,7 @@ int k_release_processor(void)
 	{
 		if(gp_current_process->m_state == RUN){
 				gp_current_process->m_state = RDY;
-				enqueue(&ready_priority_queue[gp_current_process->m_priority], gp_pcb_nodes[gp_current_process->m_pid]);
+				prio_enqueue(&ready_priority_queue, gp_current_process);
 		}
 	}
 	gp_current_process = scheduler();
@@ -394,6 +508,32 @@ int k_release_processor(void)
 	return RTX_OK;
 }
 
+/**
+ * Hands the processor straight to p_pcb without going through the scheduler
+ * PRE: the current process is already off the RUN state and queued where it belongs,
+ *      p_pcb is ready to run but on no queue
+ */
+int k_switch_to(PCB *p_pcb)
+{
+	PCB *p_pcb_old = gp_current_process;
+	p_pcb->m_state = RDY;
+	gp_current_process = p_pcb;
+	process_switch(p_pcb_old);
+	gp_current_process->m_state = RUN;
+	return RTX_OK;
+}
+
+/**
+ * Returns the highest priority level that has a ready process, or NUM_PRIORITY_LEVELS if none
+ */
+int k_ready_top_level(void)
+{
+	if (ready_priority_queue.bitmap == 0){
+		return NUM_PRIORITY_LEVELS;
+	}
+	return __clz(ready_priority_queue.bitmap);
+}
+
 /**
  *	Puts the current process into the blocked queue
  *  Marks the current process as blocked
@@ -402,49 +542,48 @@ void k_block_current_processs(void)
 {
 	if (gp_current_process)
 	{
-		PCB_NODE* currPro = gp_pcb_nodes[gp_current_process->m_pid];
 		gp_current_process->m_state = BLOCKED_ON_MEMORY;
-		currPro->next = NULL;
-		enqueue(&blocked_on_memory_queue[currPro->p_pcb->m_priority], currPro);
+		prio_enqueue(&blocked_on_memory_queue, gp_current_process);
 	}
 }
 
 /**
- * Puts the first PCB node of the blocked queue to the ready queue
- * Marks the first PCB node of the blocked queue as ready
+ * Finds the highest priority process blocked on memory that accepts a block from the given pool
+ * Returns a pointer to its PCB or NULL if there is none
  */
-int k_ready_first_blocked(void)
+PCB *k_find_blocked_on_memory(int pool)
 {
-	int i;
-	
-	if(!isEmpty(&blocked_on_memory_queue[SYS_PROC])){
-		int priority = 0;
-		PCB_NODE* nowReady = dequeue(&blocked_on_memory_queue[SYS_PROC]);
-		(nowReady->p_pcb)->m_state = RDY;
-		priority = nowReady->p_pcb->m_priority;
-		enqueue(&ready_priority_queue[priority], nowReady);
-		return priority;
-	}
-	
-	for (i = 0; i < 5; i++){
-		if (!isEmpty(&blocked_on_memory_queue[i])){
-			int priority = 0;
-			PCB_NODE* nowReady = dequeue(&blocked_on_memory_queue[i]);
-			(nowReady->p_pcb)->m_state = RDY;
-			priority = nowReady->p_pcb->m_priority;
-			enqueue(&ready_priority_queue[priority], nowReady);
-			return priority;
+	U32 levels = blocked_on_memory_queue.bitmap;
+	
+	while (levels != 0){
+		int level = __clz(levels);
+		PCB *cur = blocked_on_memory_queue.level[level].head;
+		while (cur != NULL){
+			if (cur->m_mem_first_pool <= pool && pool <= cur->m_mem_last_pool)
+				return cur;
+			cur = cur->mp_next;
 		}
+		levels &= ~(0x80000000 >> level);
 	}
-	return -1;
+	return NULL;
+}
+
+/**
+ * Moves a process from the blocked on memory queue to the ready queue
+ * Marks the process as ready
+ */
+void k_ready_blocked_on_memory(PCB *pcb)
+{
+	prio_remove(&blocked_on_memory_queue, pcb);
+	pcb->m_state = RDY;
+	prio_enqueue(&ready_priority_queue, pcb);
 }
 
 void k_ready_process(int pid)
 {
-	PCB_NODE* currPro = gp_pcb_nodes[pid];
-	gp_pcb_nodes[pid]->p_pcb->m_state = RDY;
-	currPro->next = NULL;
-	enqueue(&ready_priority_queue[currPro->p_pcb->m_priority], currPro);
+	PCB* currPro = gp_pcbs[pid];
+	currPro->m_state = RDY;
+	prio_enqueue(&ready_priority_queue, currPro);
 }
 
 PCB* k_get_current_process()
@@ -452,77 +591,92 @@ PCB* k_get_current_process()
 	return gp_current_process;
 }
 
+/**
+ * Returns the PID of the process the kernel is acting for:
+ * the running i-process if there is one, the current process otherwise
+ */
+U32 k_get_current_pid()
+{
+	return (g_iproc_pid != -1) ? g_iproc_pid : gp_current_process->m_pid;
+}
+
 // HotKey #1: printing to the RTX system debug terminal all the procs currently on the ready queue
 void k_print_ready_queue()
 {
 	int i = 0;
-	char num = '0';
+	char line[48];
 	uart1_put_string("\n\r\n\r----- PROCESSES CURRENTLY IN READY QUEUE -----\n\r\n\r");
-	uart1_put_string("Current running process with PID ");
-	uart1_put_char(num+gp_current_process->m_pid);
-	uart1_put_string("\n\r");
-	
-	for (i = 0; i < 4; i++){
-		if(!isEmpty(&ready_priority_queue[i])){
-			PCB_NODE* cur = ready_priority_queue[i].head;
-			uart1_put_string("\n\rPriority ");
-			uart1_put_char(num+i);
-			uart1_put_string(":\n\r");
+	sprintf(line, "Current running process with PID %d\n\r", gp_current_process->m_pid);
+	uart1_put_string((unsigned char *)line);
+	
+	for (i = HIGH; i <= LOWEST; i++){
+		if(!isEmpty(&ready_priority_queue.level[PRIO_LEVEL(i)])){
+			PCB* cur = ready_priority_queue.level[PRIO_LEVEL(i)].head;
+			sprintf(line, "\n\rPriority %d:\n\r", i);
+			uart1_put_string((unsigned char *)line);
 			
 			while(cur != NULL){
-				uart1_put_string("\t Process with PID ");
-				uart1_put_char(num+cur->p_pcb->m_pid);
-				uart1_put_string("\n\r");
-				cur = cur->next;
+				sprintf(line, "\t Process with PID %d\n\r", cur->m_pid);
+				uart1_put_string((unsigned char *)line);
+				cur = cur->mp_next;
 			}
 		}
 	}
 	
-	if(!isEmpty(&ready_priority_queue[SYS_PROC])){
-		PCB_NODE* cur = ready_priority_queue[SYS_PROC].head;
+	if(!isEmpty(&ready_priority_queue.level[PRIO_LEVEL(SYS_PROC)])){
+		PCB* cur = ready_priority_queue.level[PRIO_LEVEL(SYS_PROC)].head;
 		uart1_put_string("\n\rSystem Priority:\n\r");
 		
 		while(cur != NULL){
-			uart1_put_string("\t Process with PID ");
-			uart1_put_char(num+cur->p_pcb->m_pid);
-			uart1_put_string("\n\r");
-			cur = cur->next;
+			sprintf(line, "\t Process with PID %d\n\r", cur->m_pid);
+			uart1_put_string((unsigned char *)line);
+			cur = cur->mp_next;
 		}
 	}
 }
 
+// HotKey #4: printing to the RTX system debug terminal the stack high-water mark of every process
+void k_print_stack_usage()
+{
+	int i = 0;
+	char line[48];
+	uart1_put_string("\n\r\n\r----- STACK USAGE (BYTES USED / SIZE) -----\n\r\n\r");
+	
+	for (i = 0; i < NUM_PROCS; i++){
+		sprintf(line, "\t Process with PID %d: %d / %d\n\r", i, k_get_stack_high_water(i), gp_pcbs[i]->m_stack_size);
+		uart1_put_string((unsigned char *)line);
+	}
+}
+
 // HotKey #2: printing to the RTX system debug terminal all the procs currently on the blocked on memory queue
 void k_print_blocked_on_memory_queue()
 {
 	int i = 0;
-	char num = '0';
+	char line[48];
 	uart1_put_string("\n\r\n\r----- PROCESSES CURRENTLY IN BLOCKED ON MEMORY QUEUE -----\n\r");
 	
-	for (i = 0; i < 4; i++){
-		if(!isEmpty(&blocked_on_memory_queue[i])){
-			PCB_NODE* cur = blocked_on_memory_queue[i].head;
-			uart1_put_string("\n\rPriority ");
-			uart1_put_char(num+i);
-			uart1_put_string(":\n\r");
+	for (i = HIGH; i <= LOWEST; i++){
+		if(!isEmpty(&blocked_on_memory_queue.level[PRIO_LEVEL(i)])){
+			PCB* cur = blocked_on_memory_queue.level[PRIO_LEVEL(i)].head;
+			sprintf(line, "\n\rPriority %d:\n\r", i);
+			uart1_put_string((unsigned char *)line);
 			
 			while(cur != NULL){
-				uart1_put_string("\t Process with PID ");
-				uart1_put_char(num+cur->p_pcb->m_pid);
-				uart1_put_string("\n\r");
-				cur = cur->next;
+				sprintf(line, "\t Process with PID %d\n\r", cur->m_pid);
+				uart1_put_string((unsigned char *)line);
+				cur = cur->mp_next;
 			}
 		}
 	}
 	
-	if(!isEmpty(&blocked_on_memory_queue[SYS_PROC])){
-		PCB_NODE* cur = blocked_on_memory_queue[SYS_PROC].head;
+	if(!isEmpty(&blocked_on_memory_queue.level[PRIO_LEVEL(SYS_PROC)])){
+		PCB* cur = blocked_on_memory_queue.level[PRIO_LEVEL(SYS_PROC)].head;
 		uart1_put_string("\n\rSystem Priority:\n\r");
 		
 		while(cur != NULL){
-			uart1_put_string("\t Process with PID ");
-			uart1_put_char(num+cur->p_pcb->m_pid);
-			uart1_put_string("\n\r");
-			cur = cur->next;
+			sprintf(line, "\t Process with PID %d\n\r", cur->m_pid);
+			uart1_put_string((unsigned char *)line);
+			cur = cur->mp_next;
 		}
 	}
 }
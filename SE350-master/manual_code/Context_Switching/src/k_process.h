@@ -17,17 +17,26 @@
 #define INITIAL_xPSR 0x01000000        /* user process initial xPSR value */
 
 /* ----- Functions ----- */
+void set_proc_table(void);             /* fill out the initialization table */
 void process_init(void);               /* initialize all procs in the system */
 PCB *scheduler(void);                  /* pick the pid of the next to run process */
 int k_release_processor(void);           /* kernel release_process function */
+int k_switch_to(PCB *p_pcb);             /* switch to a process without the scheduler */
+int k_ready_top_level(void);             /* highest priority level with a ready process */
 void k_block_current_processs(void);    /* take the current process and put it into the blocked queue*/
-int k_ready_first_blocked(void);
+PCB *k_find_blocked_on_memory(int pool);	/* highest priority process waiting for a block of the pool */
+void k_ready_blocked_on_memory(PCB *pcb);
 void k_ready_process(int pid);
 PCB* k_get_current_process(void);
+U32 k_get_current_pid(void);
+
+void k_stack_overflow(PCB *p_pcb);
+int k_get_stack_high_water(int process_id);
 
 #ifdef DEBUG_HOTKEYS	
 	void k_print_ready_queue(void);
 	void k_print_blocked_on_memory_queue(void);
+	void k_print_stack_usage(void);
 #endif
 
 extern U32 *alloc_stack(U32 size_b);   /* allocate stack for a process */
@@ -8,6 +8,7 @@
 #ifndef K_RTX_H_
 #define K_RTX_H_
 
+#include <stdint.h>
 #include "k_ipc.h"
 
 /*----- Definitations -----*/
@@ -38,6 +39,8 @@
 	#define DEBUG_HOTKEY_1 '!'
 	#define DEBUG_HOTKEY_2 '@'
 	#define DEBUG_HOTKEY_3 '#'
+	#define DEBUG_HOTKEY_4 '$'
+	#define DEBUG_HOTKEY_5 '^'
 #endif
 
 #ifdef DEBUG_0
@@ -46,20 +49,38 @@
 	#define USR_SZ_STACK 0x100         /* user proc stack size 218B  */
 #endif /* DEBUG_0 */
 
+#define MEM_MAGAZINE_SIZE 4	/* blocks a process may keep for cached_request_memory_block() */
+
+#define STACK_FILL   0xA5A5A5A5	/* unused stack words hold this pattern */
+#define STACK_CANARY 0xDEADC0DE	/* lowest word of every stack */
+
+/* Number of user priority levels (HIGH..LOWEST), may be raised up to 30 */
+#ifndef NUM_USR_PRIORITIES
+	#define NUM_USR_PRIORITIES 4
+#endif
+
+#if (NUM_USR_PRIORITIES < 4) || (NUM_USR_PRIORITIES > 30)
+	#error "NUM_USR_PRIORITIES must be between 4 and 30"
+#endif
+
 /* Process Priority. The bigger the number is, the lower the priority is*/
 #define HIGH    0
 #define MEDIUM  1
 #define LOW     2
-#define LOWEST  3
-#define NULL_PROC 4 /* the hidden priority for the null process only */
-#define SYS_PROC 5 /* special priority for system processes KCD, CRT, and Wall Clock (and set priority process)*/
+#define LOWEST  (NUM_USR_PRIORITIES - 1)
+#define NULL_PROC NUM_USR_PRIORITIES /* the hidden priority for the null process only */
+#define SYS_PROC (NUM_USR_PRIORITIES + 1) /* special priority for system processes KCD, CRT, and Wall Clock (and set priority process)*/
+
+/* Scheduling levels: level 0 is SYS_PROC, then HIGH..LOWEST, then NULL_PROC last */
+#define NUM_PRIORITY_LEVELS (NUM_USR_PRIORITIES + 2)
+#define PRIO_LEVEL(prio) (((prio) == SYS_PROC) ? 0 : (prio) + 1)
+#define LEVEL_PRIO(level) (((level) == 0) ? SYS_PROC : (level) - 1)
 
 /*----- Types -----*/
-typedef unsigned char U8;
 typedef unsigned int U32;
 
 /* process states, note we only assume three states in this example */
-typedef enum {NEW = 0, RDY, RUN, BLOCKED_ON_MEMORY, BLOCKED_ON_RECEIVE, INTRPT} PROC_STATE_E;  
+typedef enum {NEW = 0, RDY, RUN, BLOCKED_ON_MEMORY, BLOCKED_ON_RECEIVE, BLOCKED_ON_QUOTA, BLOCKED_ON_SEND, BLOCKED_ON_TIMER, INTRPT} PROC_STATE_E;  
 
 /* Message tyes */
 typedef enum {
@@ -70,7 +91,8 @@ typedef enum {
 	MSG_KCD_DISPATCH,
 	MSG_WALL_CLOCK,
 	MSG_COUNT_REPORT,
-	MSG_WAKEUP10
+	MSG_WAKEUP10,
+	MSG_REPLY	/* set by reply(), send_receive() only accepts this type */
 } MSG_TYPE_E;
 
 // Keyboard command list
@@ -79,6 +101,36 @@ typedef struct kc_list {
 	int pid;
 } KC_LIST;
 
+/* Queue of PCBs linked through their own mp_next/mp_prev fields */
+typedef struct queue
+{
+	struct pcb *tail;
+	struct pcb *head;
+} QUEUE;
+
+/* 
+  Something the timer acts on at a given tick: a delayed message,
+  a process waiting with a timeout when mp_pcb is set,
+  or a set_timer() timer when neither mp_env nor mp_pcb is set
+*/
+typedef struct timer_node {
+	struct timer_node *mp_next;
+	struct timer_node *mp_prev;	/* previous node in the same wheel slot */
+	struct timer_node **mpp_slot;	/* wheel slot holding the node, NULL if it is not on the wheel */
+	ENVELOPE *mp_env;
+	struct pcb *mp_pcb;	/* process woken on expiry, NULL for a delayed message */
+	U32 m_expiry;	/* value of g_timer_count at which the node expires */
+	U32 m_period;	/* ticks between the deadlines of a periodic timer, 0 for one shot */
+	U16 m_msg_type;	/* type of the message a timer sends its owner */
+	U8 m_owner;	/* process that set the timer */
+	U8 m_gen;	/* bumped on every free so stale handles are refused */
+} TIMER_NODE;
+
+typedef struct timer_queue {
+	TIMER_NODE *head;
+	TIMER_NODE *tail;
+} TIMER_QUEUE;
+
 /*
   PCB data structure definition.
   You may want to add your own member variables
@@ -91,6 +143,23 @@ typedef struct pcb
 	PROC_STATE_E m_state;   /* state of the process */
 	U32 m_priority;
 	ENV_QUEUE env_q;
+	struct pcb *mp_next;	/* next PCB on the queue this process is on */
+	struct pcb *mp_prev;	/* previous PCB on the queue this process is on */
+	int m_mem_first_pool;	/* smallest pool a process blocked on memory accepts */
+	int m_mem_last_pool;	/* largest pool a process blocked on memory accepts */
+	void *mp_mem_blk;	/* block handed to the process when it leaves BLOCKED_ON_MEMORY */
+	U32 *mp_stack_base;	/* lowest address of the stack, holds STACK_CANARY */
+	U32 m_stack_size;	/* stack size in bytes */
+	void *mp_magazine[MEM_MAGAZINE_SIZE];	/* released default blocks kept for the next request */
+	U32 m_mag_count;	/* number of blocks in mp_magazine */
+	int m_blks_held;	/* memory blocks owned by the process, magazine included */
+	int m_mem_quota;	/* most blocks the process may own at once, 0 for no limit */
+	U32 m_rcv_type_mask;	/* message types a receive-blocked process waits for */
+	int m_rcv_sender;	/* sender a receive-blocked process waits for, or MSG_SENDER_ANY */
+	TIMER_NODE m_timer;	/* wakes the process when a timed receive or a sleep runs out */
+	int m_timer_expired;	/* set by the timer when m_timer ran out */
+	int m_mbox_limit;	/* most messages the mailbox holds, 0 for no limit */
+	QUEUE m_senders;	/* processes blocked sending to the full mailbox */
 } PCB;
 
 /* initialization table item */
@@ -100,26 +169,30 @@ typedef struct proc_init
 	int m_priority;         /* initial priority, not used in this example. */ 
 	int m_stack_size;       /* size of stack in words */
 	void (*mpf_start_pc) ();/* entry point of the process */ 
+	int m_mem_quota;        /* most memory blocks owned at once, 0 for no limit */
+	int m_mbox_limit;       /* most messages queued in the mailbox, 0 for no limit */
 	//U32 *mp_sp;		/* stack pointer of the process */	
 } PROC_INIT;
 
-typedef struct pcb_node
-{
-	struct pcb_node *next;
-	PCB *p_pcb;
-} PCB_NODE;
-
-typedef struct queue
+/* One queue per scheduling level plus a bitmap of the non-empty levels */
+typedef struct prio_queue
 {
-	PCB_NODE *tail;
-	PCB_NODE *head;
-} QUEUE;
+	U32 bitmap; /* bit (31 - level) is set iff level[level] is not empty */
+	QUEUE level[NUM_PRIORITY_LEVELS];
+} PRIO_QUEUE;
 
-void enqueue(QUEUE *q, PCB_NODE *n);
-PCB_NODE* dequeue(QUEUE *q);
-PCB_NODE* peek(QUEUE *q);
+void enqueue(QUEUE *q, PCB *n);
+PCB* dequeue(QUEUE *q);
+PCB* peek(QUEUE *q);
+int remove(QUEUE *q, PCB *n);
 int isEmpty(QUEUE *q);
 
+void prio_init(PRIO_QUEUE *pq);
+void prio_enqueue(PRIO_QUEUE *pq, PCB *n);
+PCB* prio_dequeue(PRIO_QUEUE *pq);
+int prio_remove(PRIO_QUEUE *pq, PCB *n);
+int prio_empty(PRIO_QUEUE *pq);
+
 ENVELOPE* msg_dequeue(ENV_QUEUE* q, int* sender_ID);
 void msg_enqueue(ENV_QUEUE* q, ENVELOPE* msg);
 int msg_empty(ENV_QUEUE* q);
@@ -127,33 +200,61 @@ int msg_empty(ENV_QUEUE* q);
 #define __SVC_0  __svc_indirect(0)
 
 extern int k_release_processor(void);
-#define release_processor() _release_processor((U32)k_release_processor)
+#define release_processor() _release_processor((U32)(uintptr_t)k_release_processor)
 extern int __SVC_0 _release_processor(U32 p_func);
 
 extern void *k_request_memory_block(void);
-#define request_memory_block() _request_memory_block((U32)k_request_memory_block)
+#define request_memory_block() _request_memory_block((U32)(uintptr_t)k_request_memory_block)
 extern void *_request_memory_block(U32 p_func) __SVC_0;
 /* __SVC_0 can also be put at the end of the function declaration */
 
+extern void *k_request_memory_block_sized(U32 size_b);
+#define request_memory_block_sized(size_b) _request_memory_block_sized((U32)(uintptr_t)k_request_memory_block_sized, size_b)
+extern void *_request_memory_block_sized(U32 p_func, U32 size_b) __SVC_0;
+
 extern int k_release_memory_block(void *);
-#define release_memory_block(p_mem_blk) _release_memory_block((U32)k_release_memory_block, p_mem_blk)
+#define release_memory_block(p_mem_blk) _release_memory_block((U32)(uintptr_t)k_release_memory_block, p_mem_blk)
 extern int _release_memory_block(U32 p_func, void *p_mem_blk) __SVC_0;
 
+/* Served from the calling process's magazine without trapping when possible */
+extern void *cached_request_memory_block(void);
+extern int cached_release_memory_block(void *p_mem_blk);
+
 extern int k_non_block_release_memory_block(void *);
-#define non_block_release_memory_block(p_mem_blk) _non_block_release_memory_block((U32)k_non_block_release_memory_block, p_mem_blk)
+#define non_block_release_memory_block(p_mem_blk) _non_block_release_memory_block((U32)(uintptr_t)k_non_block_release_memory_block, p_mem_blk)
 extern int _non_block_release_memory_block(U32 p_func, void *p_mem_blk) __SVC_0;
 
 extern int k_get_process_priority(int pid);
-#define get_process_priority(pid) _get_process_priority((U32)k_get_process_priority, pid)
+#define get_process_priority(pid) _get_process_priority((U32)(uintptr_t)k_get_process_priority, pid)
 extern int _get_process_priority(U32 p_func, int pid) __SVC_0;
 /* __SVC_0 can also be put at the end of the function declaration */
 
+extern int k_get_stack_high_water(int pid);
+#define get_stack_high_water(pid) _get_stack_high_water((U32)(uintptr_t)k_get_stack_high_water, pid)
+extern int _get_stack_high_water(U32 p_func, int pid) __SVC_0;
+
 extern int k_set_process_priority(int pid, int prio);
-#define set_process_priority(pid, prio) _set_process_priority((U32)k_set_process_priority, pid, prio)
+#define set_process_priority(pid, prio) _set_process_priority((U32)(uintptr_t)k_set_process_priority, pid, prio)
 extern int _set_process_priority(U32 p_func, int pid, int prio) __SVC_0;
 
+/* Sends env to process_id after delay ms, RTX_ERR for a bad pid or delay, an env the caller does not own
+   or when every timer node is in use; env stays with the caller on RTX_ERR */
 extern int k_delayed_send(int process_id, void * env, int delay);
-#define delayed_send(pid, env, delay) _delayed_send((U32)k_delayed_send, pid, env, delay)
+#define delayed_send(pid, env, delay) _delayed_send((U32)(uintptr_t)k_delayed_send, pid, env, delay)
 extern int _delayed_send(U32 p_func, int target_pid, void* message_envelope, int delay) __SVC_0;
 
+/* Sends the caller a message of the given type after delay ms and then every period ms (0 for once),
+   RTX_ERR when every timer node is in use */
+extern int k_set_timer(int type, int delay, int period);
+#define set_timer(type, delay, period) _set_timer((U32)(uintptr_t)k_set_timer, type, delay, period)
+extern int _set_timer(U32 p_func, int type, int delay, int period) __SVC_0;
+
+extern int k_cancel_timer(int handle);
+#define cancel_timer(handle) _cancel_timer((U32)(uintptr_t)k_cancel_timer, handle)
+extern int _cancel_timer(U32 p_func, int handle) __SVC_0;
+
+extern int k_sleep_ms(int ms);
+#define sleep_ms(ms) _sleep_ms((U32)(uintptr_t)k_sleep_ms, ms)
+extern int _sleep_ms(U32 p_func, int ms) __SVC_0;
+
 #endif // ! K_RTX_H_
@@ -9,6 +9,8 @@
 #include "uart_polling.h"
 #include "k_memory.h"
 #include "k_process.h"
+#include "k_sys_proc.h"
+#include "k_timer.h"
 #include "timer.h"
 #include "uart_def.h"
 
@@ -20,8 +22,12 @@ void k_rtx_init(void)
 	uart1_init();       // uart1, polling
 	timer_init(0); /* initialize timer 0 */
 	uart0_init();   
+	set_proc_table();
 	memory_init();
 	process_init();
+	timer_nodes_init();
+	msg_stubs_init();
+	msg_signals_init();
 	__enable_irq();
 
 	/* start the first process */
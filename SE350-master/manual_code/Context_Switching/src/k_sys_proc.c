@@ -1,6 +1,8 @@
 #include <LPC17xx.h>
 #include "string.h"
 #include "k_sys_proc.h"
+#include "k_timer.h"
+#include "timer.h"
 #include "k_rtx.h"
 #include "k_ipc.h"
 #include "k_memory.h"
@@ -8,16 +10,17 @@
 #include "uart_def.h"
 #include "printf.h"
 
-ENV_QUEUE t_queue;
 extern volatile uint32_t g_timer_count;
 extern PCB* gp_current_process;
+extern int g_iproc_pid;
+extern PRIO_QUEUE blocked_on_receive_queue;
 extern KC_LIST g_kc_reg[KC_MAX_COMMANDS];
 int uart_asm_preemption_flag = 0;
-int send_message_preemption_flag = 1; // 0 for not preempting and 1 otherwise
 
 char g_input_buffer[INPUT_BUFFER_SIZE]; // buffer char array to hold the input
 int g_input_buffer_index = 0; // current index of the buffer such that all indices before this one holds a char
 U8 g_char_in;
+U32 g_input_dropped = 0; // echoes and commands lost because even the memory reserve was empty
 U32 g_char_out_index = 0;
 ENVELOPE* g_curr_p = NULL;
 
@@ -25,18 +28,7 @@ int elapsed =0 ;
 int w_secs,w_mins,w_hours;
 int base=0;
 int show_wclock = 0;
-
-int k_delayed_send(int process_id, void * env, int delay){
-	ENVELOPE *lope = (ENVELOPE *) env;
-	int response = 0;
-	//__disable_irq();
-	lope->delay = g_timer_count + delay;
-	send_message_preemption_flag = 0;
-	response = k_send_message(TIMER_PID, env);
-	send_message_preemption_flag = 1;
-	//__enable_irq();
-	return response;
-}
+int wclock_timer = RTX_ERR; // periodic timer sending the wall clock its MSG_WALL_CLOCK ticks
 
 /**
  * The Null Process with priority 4
@@ -44,6 +36,9 @@ int k_delayed_send(int process_id, void * env, int delay){
 void null_proc(void) {
 	while (1) {
 		printf("Looping null process\n\r");
+#ifdef TIMER_TICKLESS
+		__wfi(); // nothing to run until an interrupt, the timer only raises one at the next deadline
+#endif
 		k_release_processor();
 	}
 }
@@ -51,95 +46,66 @@ void null_proc(void) {
 ENVELOPE* dequeue_env_queue(ENV_QUEUE *q){
 	ENVELOPE *curHead = q->head;
 	if (msg_empty(q)) return NULL;
-	if (q->head == q->tail)
-	{
-		q->head = NULL;
-		q->tail = NULL;
-	}
-	else
-		q->head = q->head->nextMsg;
-	curHead->nextMsg = NULL;
+	msg_unlink(q, NULL, curHead);
 	return curHead;
 }
 
-ENVELOPE* k_non_blocking_receive_message(int pid){
-	PCB* timer = gp_pcbs[pid];
-	ENV_QUEUE* env_q = &(timer->env_q);
-	if(!msg_empty(env_q)){
-		return dequeue_env_queue(env_q);
-	}
-	return NULL;
-}
-
-void sorted_insert(ENVELOPE* lope){
-	lope->nextMsg = NULL;
-	if (t_queue.head == NULL){
-		t_queue.head = lope;
-		t_queue.tail = lope;
-	}
-	//Only one element currently in the queue
-	else if (t_queue.head == t_queue.tail){
-		if (t_queue.head->delay < lope->delay){
-			t_queue.head->nextMsg = lope;
-			t_queue.tail = lope;
-		}
-		else {
-			t_queue.head = lope;
-			lope->nextMsg = t_queue.tail;
-			t_queue.tail->nextMsg = NULL;
-		}
-	}
-	else {
-		//Checking bounds for when lope expiry is less than all
-		if (lope->delay < t_queue.head->delay){
-			lope->nextMsg = t_queue.head;
-			t_queue.head = lope;
-		}
-		//Checking bounds for when lope expiry is >= to all
-		else if (lope->delay >= t_queue.tail->delay){
-			t_queue.tail->nextMsg = lope;
-			t_queue.tail = lope;
-		}
-		else {
-			ENVELOPE* cur = t_queue.head;
-			ENVELOPE* prev = t_queue.head;
-			while ((cur != NULL) && (lope->delay >= cur->delay)){
-				prev = cur;
-				cur = cur->nextMsg;
-			}
-			prev->nextMsg = lope;
-			lope->nextMsg = cur;
-		}
-	}
-}
-
 void timer_i_proc(void) {
-	ENVELOPE* lope = NULL;
+	TIMER_NODE* due;
+	PCB* target;
 	int preemption_flag = 0;
+	int prev_iproc_pid;
 	__disable_irq(); // make this process non blocking
+	prev_iproc_pid = g_iproc_pid;
+	g_iproc_pid = TIMER_PID;
 	
 	LPC_TIM0->IR = (1 << 0);
 	
-	lope = k_non_blocking_receive_message(TIMER_PID);
-	
-	// request all of the new envelopes that need to be send later
-	while (lope != NULL){
-		sorted_insert(lope);
-		lope = k_non_blocking_receive_message(TIMER_PID);
-	}
+	due = timer_expire();
 	
-	send_message_preemption_flag = 0;
-	while (t_queue.head != NULL && t_queue.head->delay <= g_timer_count){
-		ENVELOPE* cur = dequeue_env_queue(&t_queue);
-		__enable_irq();
-		k_send_message (cur->destination_pid, (void *) cur);
-		__disable_irq();
-		if (gp_pcbs[cur->destination_pid]->m_priority > gp_current_process->m_priority){
+	while (due != NULL){
+		TIMER_NODE* node = due;
+		ENVELOPE* cur = node->mp_env;
+		due = node->mp_next;
+		node->mp_next = NULL;
+		
+		// a timed receive or a sleep ran out, wake the process without a message
+		if (node->mp_pcb != NULL){
+			PCB* p_pcb = node->mp_pcb;
+			p_pcb->m_timer_expired = 1;
+			if (p_pcb->m_state == BLOCKED_ON_RECEIVE || p_pcb->m_state == BLOCKED_ON_TIMER){
+				if (p_pcb->m_state == BLOCKED_ON_RECEIVE)
+					prio_remove(&blocked_on_receive_queue, p_pcb);
+				k_ready_process(p_pcb->m_pid);
+				if (PRIO_LEVEL(p_pcb->m_priority) < PRIO_LEVEL(gp_current_process->m_priority)){
+					preemption_flag = 1;
+				}
+			}
+			continue;
+		}
+		
+		if (TIMER_IS_HANDLE(node)){
+			target = gp_pcbs[node->m_owner];
+			timer_fire(node);
+		}
+		else {
+			target = gp_pcbs[cur->destination_pid];
+			timer_node_free(node);
+			__enable_irq();
+			k_send_message (cur->destination_pid, (void *) cur);
+			__disable_irq();
+		}
+		if (target->m_state == RDY && PRIO_LEVEL(target->m_priority) < PRIO_LEVEL(gp_current_process->m_priority)){
 			preemption_flag = 1;
 		}
 	}
-	send_message_preemption_flag = 1;
+#ifdef TIMER_TICKLESS
+	g_timer_count = timer_now();
+	timer_program_next();
+#else
 	g_timer_count++;
+#endif
+	g_iproc_pid = prev_iproc_pid;
 	__enable_irq();
 	
 	if (preemption_flag){
@@ -151,7 +117,10 @@ void uart_i_proc(void) {
 	uint8_t IIR_IntId;	    // Interrupt ID from IIR 		 
 	LPC_UART_TypeDef *pUart = (LPC_UART_TypeDef *)LPC_UART0;
 	ENVELOPE* msg;
+	int prev_iproc_pid;
 	__disable_irq();
+	prev_iproc_pid = g_iproc_pid;
+	g_iproc_pid = UART_IPROC_PID;
 	uart_asm_preemption_flag = 0;
 	
 	/* Reading IIR automatically acknowledges the interrupt */
@@ -166,32 +135,36 @@ void uart_i_proc(void) {
 		// Sends input to crt display
 		if (mem_empty() == 0)
 		{
-			int display_size;
-			char display_msg[3];
+			char* display_msg;
+			
+			msg = (ENVELOPE*) k_request_memory_block();
+			msg->sender_pid = UART_IPROC_PID;
+			msg->destination_pid = CRT_PID;
+			msg->nextMsg = NULL;
+			msg->message_type = MSG_CRT_DISPLAY;
+			
+			// the echo is written straight into the block
+			display_msg = (char*) msg_payload(msg);
 			if (g_char_in == '\r')
 			{
-				display_size = 3;
 				display_msg[0] = '\n';
 				display_msg[1] = g_char_in;
 				display_msg[2] = '\0';
+				msg->msg_size = 3;
 			}
 			else
 			{
-				display_size = 2;
 				display_msg[0] = g_char_in;
 				display_msg[1] = '\0';
+				msg->msg_size = 2;
 			}
-			
-			msg = (ENVELOPE*) k_request_memory_block();
-			msg->sender_pid = UART_IPROC_PID;
-			msg->destination_pid = CRT_PID;
-			msg->nextMsg = NULL;
-			msg->message_type = MSG_CRT_DISPLAY;
-			msg->delay = 0;
-			set_message(msg, display_msg, display_size*sizeof(char));
 			k_send_message(CRT_PID, msg);
 			uart_asm_preemption_flag = 1;
 		}
+		else
+		{
+			g_input_dropped++;
+		}
 		
 #ifdef DEBUG_HOTKEYS		
 		if (g_char_in == DEBUG_HOTKEY_1)
@@ -200,12 +173,16 @@ void uart_i_proc(void) {
 			k_print_blocked_on_memory_queue();
 		else if (g_char_in == DEBUG_HOTKEY_3)
 			k_print_blocked_on_receive_queue();
+		else if (g_char_in == DEBUG_HOTKEY_4)
+			k_print_stack_usage();
+		else if (g_char_in == DEBUG_HOTKEY_5)
+			k_print_blocks_held();
 #endif			
 	
 		if (g_char_in != '\r') // Any char not an enter
 		{
 #ifdef DEBUG_HOTKEYS
-			if ((g_char_in != DEBUG_HOTKEY_1)&&(g_char_in != DEBUG_HOTKEY_2)&&(g_char_in != DEBUG_HOTKEY_3))
+			if ((g_char_in != DEBUG_HOTKEY_1)&&(g_char_in != DEBUG_HOTKEY_2)&&(g_char_in != DEBUG_HOTKEY_3)&&(g_char_in != DEBUG_HOTKEY_4)&&(g_char_in != DEBUG_HOTKEY_5))
 			{
 				g_input_buffer[g_input_buffer_index] = g_char_in;
 				g_input_buffer_index++;
@@ -228,12 +205,15 @@ void uart_i_proc(void) {
 				msg->destination_pid = KCD_PID;
 				msg->nextMsg = NULL;
 				msg->message_type = MSG_CONSOLE_INPUT;
-				msg->delay = 0;
 				set_message(msg, g_input_buffer, g_input_buffer_index*sizeof(char));	
 				k_send_message(KCD_PID, msg);
 				g_input_buffer_index = 0;
 				uart_asm_preemption_flag = 1;
 			}
+			else
+			{
+				g_input_dropped++;
+			}
 		}
 		
 		g_input_buffer[g_input_buffer_index] = g_char_in;
@@ -246,7 +226,7 @@ void uart_i_proc(void) {
 				g_curr_p = (ENVELOPE*) k_non_block_receive_message(UART_IPROC_PID);
 			if (g_curr_p != NULL)
 			{
-				g_input = (char*) g_curr_p->message;
+				g_input = (char*) msg_payload(g_curr_p);
 				if (g_input[g_char_out_index] != '\0')
 				{
 					// print normal char
@@ -256,7 +236,7 @@ void uart_i_proc(void) {
 				else
 				{
 					// done printing
-					if (gp_pcb_nodes[UART_IPROC_PID]->p_pcb->env_q.head == NULL)
+					if (gp_pcbs[UART_IPROC_PID]->env_q.head == NULL)
 						pUart->IER &= (~IER_THRE);
 					pUart->THR = g_input[g_char_out_index];
 					k_non_block_release_memory_block(g_curr_p);
@@ -265,6 +245,7 @@ void uart_i_proc(void) {
 				}
 			}
 	}    
+	g_iproc_pid = prev_iproc_pid;
 	__enable_irq();
 }
 
@@ -284,7 +265,7 @@ void kcd_proc(void)
 					if (g_kc_reg[i].pid == -1)
 					{
 						g_kc_reg[i].pid = msg->sender_pid;
-						strcpy(g_kc_reg[i].command, msg->message);
+						strcpy(g_kc_reg[i].command, msg_payload(msg));
 						break;
 					}
 				}
@@ -294,7 +275,7 @@ void kcd_proc(void)
 				int i = 0;
 				int j;
 				char command[KC_MAX_CHAR];
-				char* message_curr = msg->message;
+				char* message_curr = msg_payload(msg);
 				while ((i < KC_MAX_CHAR)&&(message_curr[i] != ' ')&&(message_curr[i] != '\0'))
 				{
 					command[i] = message_curr[i];
@@ -302,30 +283,23 @@ void kcd_proc(void)
 				}
 				command[i] = '\0';
 				
-				// find end of message 
-				while (message_curr[i] != '\0')
-				{
-					i++;
-				}
-				
 				for (j = 0; j < KC_MAX_COMMANDS; j++)
 				{
 					if ((strcmp(command,g_kc_reg[j].command) == 0)&&(g_kc_reg[j].pid != -1))
 					{
-						ENVELOPE* kcd_msg = (ENVELOPE*) request_memory_block();
-						kcd_msg->sender_pid = KCD_PID;
-						kcd_msg->destination_pid = g_kc_reg[j].pid;
-						kcd_msg->nextMsg = NULL;
-						kcd_msg->message_type = MSG_KCD_DISPATCH;
-						kcd_msg->delay = 0;
-						set_message(kcd_msg, message_curr, i*sizeof(char));	
-						send_message(g_kc_reg[j].pid, kcd_msg);
+						// the command line already sits in the block, pass the block on as it is
+						msg->sender_pid = KCD_PID;
+						msg->destination_pid = g_kc_reg[j].pid;
+						msg->message_type = MSG_KCD_DISPATCH;
+						send_message(g_kc_reg[j].pid, msg);
+						msg = NULL;
 						break;
 					}
 				}
 			}
 		}
-		release_memory_block(msg);
+		if (msg != NULL)
+			cached_release_memory_block(msg);
 	}
 }
 
@@ -344,12 +318,33 @@ void crt_proc(void)
 	}
 }
 
+/**
+ * Starts the one second timer of the wall clock, telling the user on the CRT when no timer node is left
+ * Returns the timer handle, or -1 if the timer could not be started
+ */
+int wall_clock_start(void) {
+	int handle = set_timer(MSG_WALL_CLOCK, 0, 1000);
+	if (handle == RTX_ERR) {
+		ENVELOPE * error_msg = (ENVELOPE*) request_memory_block();
+		error_msg->sender_pid = WALL_CLOCK_PID;
+		error_msg->destination_pid = CRT_PID;
+		error_msg->message_type = MSG_CRT_DISPLAY;
+
+		sprintf(msg_payload(error_msg), "Wall clock: no timer available, try again later\n\r");
+		error_msg->msg_size = strlen(msg_payload(error_msg)) + 1;
+
+		send_message(CRT_PID, error_msg);
+	}
+	return handle;
+}
+
 void wall_clock_proc(void) {
 	
 	/*sends message to kcd to register the command types*/
 	ENVELOPE *msg = (ENVELOPE *)request_memory_block();
 	
 	msg->message_type = MSG_COMMAND_REGISTRATION;
+	msg->msg_prio = MSG_PRIO_HIGH;
 	msg->sender_pid = WALL_CLOCK_PID;
 	msg->destination_pid = KCD_PID;
 	set_message(msg, "%WR" + '\0', 4*sizeof(char));
@@ -359,6 +354,7 @@ void wall_clock_proc(void) {
 	msg->sender_pid = WALL_CLOCK_PID;
 	msg->destination_pid = KCD_PID;
 	msg->message_type = MSG_COMMAND_REGISTRATION;
+	msg->msg_prio = MSG_PRIO_HIGH;
 	set_message(msg, "%WS" + '\0', 4*sizeof(char));
 	send_message(KCD_PID, msg);	
 	
@@ -366,26 +362,26 @@ void wall_clock_proc(void) {
 	msg->sender_pid = WALL_CLOCK_PID;
 	msg->destination_pid = KCD_PID;
 	msg->message_type = MSG_COMMAND_REGISTRATION;
+	msg->msg_prio = MSG_PRIO_HIGH;
 	set_message(msg, "%WT" + '\0', 4*sizeof(char));
 	send_message(KCD_PID, msg);	
 
 	while(1){
 
 		ENVELOPE * rec_msg= (ENVELOPE*) receive_message(NULL);
-		char * char_message = (char *) rec_msg->message;
+		char * char_message = (char*) msg_payload(rec_msg);
 		if(rec_msg->message_type == MSG_WALL_CLOCK && 
-			rec_msg->sender_pid == WALL_CLOCK_PID && show_wclock ==1) {
+			rec_msg->sender_pid == TIMER_PID && show_wclock ==1) {
 			int curr_time = 0;
 			int s1, s2, m1, m2, h1, h2;
 			
-			ENVELOPE * delay_msg = (ENVELOPE*) request_memory_block();
-				
 			ENVELOPE * w_clock = (ENVELOPE*) request_memory_block();
 			w_clock->sender_pid = WALL_CLOCK_PID;
 			w_clock->destination_pid = CRT_PID;
 			w_clock->message_type = MSG_CRT_DISPLAY;
 
-			curr_time = g_timer_count - elapsed + base;
+			// the tick carries its deadline, so the time shown does not depend on when it is handled
+			curr_time = *(U32*) msg_payload(rec_msg) - elapsed + base;
 			w_secs= (curr_time /1000)%60;
 					s2=w_secs%10;
 				s1=w_secs/10;
@@ -395,35 +391,22 @@ void wall_clock_proc(void) {
 			w_hours= (curr_time/(3600000))%24;
 				h2=w_hours%10;
 			h1=w_hours/10;
-			w_clock->message = w_clock + HEADER_OFFSET;
-			sprintf(w_clock->message, "%d%d:%d%d:%d%d\n\r", h1,h2,m1,m2,s1,s2); 
+			sprintf(msg_payload(w_clock), "%d%d:%d%d:%d%d\n\r", h1,h2,m1,m2,s1,s2);
+			w_clock->msg_size = strlen(msg_payload(w_clock)) + 1;
 
 			send_message(CRT_PID, w_clock);
-				
-	
-				delay_msg->message_type=MSG_WALL_CLOCK;			
-				delay_msg->sender_pid=WALL_CLOCK_PID;
-				delay_msg->destination_pid=WALL_CLOCK_PID;
-				delay_msg->message=NULL;
-				delayed_send(WALL_CLOCK_PID, delay_msg, 1000);
 		}
-		else {
+		else if (rec_msg->message_type != MSG_WALL_CLOCK) {
 			if (char_message[2]== 'R') {
-				ENVELOPE *msg =(ENVELOPE *) request_memory_block();
-				msg->message_type=MSG_WALL_CLOCK;			
-				msg->sender_pid=WALL_CLOCK_PID;
-				msg->destination_pid=WALL_CLOCK_PID;
-				msg->message=NULL;
-
 				w_secs=0;
 				w_mins=0;
 				w_hours=0;
 
 				base = 0;
-				elapsed = g_timer_count;
+				elapsed = timer_now();
 				if (show_wclock == 0){
-					show_wclock = 1;
-					send_message(WALL_CLOCK_PID, msg);
+					wclock_timer = wall_clock_start();
+					show_wclock = (wclock_timer != RTX_ERR) ? 1 : 0;
 				}
 			}
 			if (char_message[2]== 'S') {
@@ -434,11 +417,6 @@ void wall_clock_proc(void) {
 				{
 				
 					int h1,h2,m1,m2,s1,s2;			 
-					ENVELOPE *msg =(ENVELOPE *) request_memory_block();
-					msg->message_type=MSG_WALL_CLOCK;			
-					msg->sender_pid=WALL_CLOCK_PID;
-					msg->destination_pid=WALL_CLOCK_PID;
-					msg->message=NULL;
 					
 					h1=char_message[4] - '0';
 					h2=char_message[5] - '0';
@@ -455,15 +433,17 @@ void wall_clock_proc(void) {
 
 					w_secs= s1*10 + s2;
 
-					elapsed = g_timer_count;
+					elapsed = timer_now();
 					base = ((w_hours * 3600) + (w_mins * 60) + w_secs) * 1000;
 					if (show_wclock == 0){
-						show_wclock = 1;
-						send_message(WALL_CLOCK_PID, msg);
+						wclock_timer = wall_clock_start();
+						show_wclock = (wclock_timer != RTX_ERR) ? 1 : 0;
 					}
 				}
 			}
 			else if (char_message[2]== 'T') {
+				if (show_wclock == 1)
+					cancel_timer(wclock_timer);
 				show_wclock=0;
 			}
 		}
@@ -476,17 +456,23 @@ void set_priority_proc(void) {
 	/*sends message to kcd to register the command types*/
 	ENVELOPE *msg = (ENVELOPE *)request_memory_block();
 	msg->message_type = MSG_COMMAND_REGISTRATION;
+	msg->msg_prio = MSG_PRIO_HIGH;
 	msg->sender_pid = SET_PRIORITY_PID;
 	msg->destination_pid = KCD_PID;
-	set_message(msg, "%C" + '\0', 4*sizeof(char));
+	set_message(msg, "%C" + '\0', 3*sizeof(char));
 	send_message(KCD_PID, msg);
 	while(1){
-		int priority, pid;
+		int priority, pid, i;
 		ENVELOPE * rec_msg = (ENVELOPE*) receive_message(NULL);
-		char * char_message = (char *) rec_msg->message;
-		if ((char_message[3] >= '1')&&(char_message[3] <= '6')&&(char_message[4] == ' ')&&(char_message[5] >= '0')&&(char_message[5] <= '3') && (char_message[6] == '\0')){
+		char * char_message = (char*) msg_payload(rec_msg);
+		
+		// priority may take more than one digit when NUM_USR_PRIORITIES > 10
+		priority = 0;
+		for (i = 5; (char_message[i] >= '0')&&(char_message[i] <= '9')&&(i < 7); i++){
+			priority = priority*10 + (char_message[i] - '0');
+		}
+		if ((char_message[3] >= '1')&&(char_message[3] <= '6')&&(char_message[4] == ' ')&&(i > 5)&&(priority <= LOWEST) && (char_message[i] == '\0')){
 			pid = char_message[3] - '0';
-			priority = char_message[5] - '0';
 			//printf("message %s", char_message);
 			//printf("pid %d priority %d", pid, priority);
 			set_process_priority(pid, priority);	
@@ -497,8 +483,8 @@ void set_priority_proc(void) {
 			error_msg->destination_pid = CRT_PID;
 			error_msg->message_type = MSG_CRT_DISPLAY;
 
-			error_msg->message = error_msg + HEADER_OFFSET;
-			sprintf(error_msg->message, "You have entered an invalid input\n\r"); 
+			sprintf(msg_payload(error_msg), "You have entered an invalid input\n\r");
+			error_msg->msg_size = strlen(msg_payload(error_msg)) + 1;
 
 			send_message(CRT_PID, error_msg);
 		}
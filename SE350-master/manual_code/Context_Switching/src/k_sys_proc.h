@@ -7,8 +7,6 @@
 
 #define INPUT_BUFFER_SIZE (MEMORY_BLOCK_SIZE-HEADER_OFFSET)
 
-extern volatile U32 g_timer_count;
-
 /* indefinitely releases the processor */
 void null_proc(void);
 
@@ -24,6 +22,9 @@ void kcd_proc(void);
 /* CRT process */
 void crt_proc(void);
 
+/* starts the wall clock timer, -1 if none is left */
+int wall_clock_start(void);
+
 /* Wall clock process */
 void wall_clock_proc(void);
 
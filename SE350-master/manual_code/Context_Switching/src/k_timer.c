@@ -0,0 +1,353 @@
+/**
+ * @file:   k_timer.c
+ * @brief:  kernel timer wheel and timer node routines
+ */
+
+#include <LPC17xx.h>
+#include "k_timer.h"
+#include "k_memory.h"
+#include "k_process.h"
+#include "timer.h"
+
+TIMER_NODE *g_timer_wheel[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS]; // armed nodes, doubly linked per slot
+U32 g_wheel_count = 0; // nodes on the wheel
+TIMER_NODE g_timer_nodes[NUM_TIMER_NODES];
+TIMER_NODE *gp_timer_free = NULL; // unused timer nodes
+U32 g_delayed_count = 0; // nodes holding a delayed message
+extern int g_iproc_pid;
+#ifdef TIMER_TICKLESS
+U32 g_wheel_now = 0; // first tick the wheel has not handled yet
+#endif
+
+/**
+ * Links every timer node into the free list
+ */
+void timer_nodes_init(void) {
+	int i, j;
+	gp_timer_free = NULL;
+	for (i = 0; i < NUM_TIMER_NODES; i++) {
+		g_timer_nodes[i].mp_env = NULL;
+		g_timer_nodes[i].mp_next = gp_timer_free;
+		gp_timer_free = &g_timer_nodes[i];
+	}
+	for (i = 0; i < TIMER_WHEEL_LEVELS; i++)
+		for (j = 0; j < TIMER_WHEEL_SLOTS; j++)
+			g_timer_wheel[i][j] = NULL;
+	g_wheel_count = 0;
+	g_delayed_count = 0;
+}
+
+void timer_node_free(TIMER_NODE *node) {
+	if (node->mp_env != NULL)
+		g_delayed_count--;
+	node->mp_env = NULL;
+	node->m_gen++;
+	node->mp_next = gp_timer_free;
+	gp_timer_free = node;
+}
+
+/**
+ * Hands an envelope to the timer, which sends it to process_id after delay ticks
+ * The expiry is kept in a timer node since envelopes carry no delay
+ * At most NUM_DELAYED_MSGS are pending so that set_timer() keeps the rest of the nodes
+ * Returns -1 if process_id is not a process, the caller does not own env, delay is negative
+ * or no timer node is left for a delayed message, 0 otherwise; env stays with the caller on -1
+ */
+int k_delayed_send(int process_id, void * env, int delay){
+	ENVELOPE *lope = (ENVELOPE *) env;
+	TIMER_NODE *node;
+	if (process_id < 0 || process_id >= NUM_PROCS || delay < 0)
+		return RTX_ERR;
+	__disable_irq();
+	node = gp_timer_free;
+	// the timer i-process takes over env, so it has to be the caller's to give
+	if (!mem_is_owner(lope, k_get_current_pid()) || node == NULL || g_delayed_count >= NUM_DELAYED_MSGS) {
+		__enable_irq();
+		return RTX_ERR;
+	}
+	gp_timer_free = node->mp_next;
+	g_delayed_count++;
+	
+	lope->destination_pid = process_id;
+	mem_set_owner(lope, TIMER_PID);
+	node->mp_env = lope;
+	node->mp_pcb = NULL;
+	timer_arm(node, delay);
+	__enable_irq();
+	return RTX_OK;
+}
+
+/**
+ * Puts a node into the wheel slot for its expiry, now is the next tick the wheel handles
+ * Expiries are compared as distances from now so they stay ordered when g_timer_count wraps
+ * PRE: interrupts are disabled
+ */
+void timer_wheel_insert(TIMER_NODE *node, U32 now) {
+	U32 delta = node->m_expiry - now;
+	U32 expiry = node->m_expiry;
+	TIMER_NODE **slot;
+	int level = 0;
+	
+	if ((int) delta < 0) {
+		// already due, fire on the next tick
+		expiry = now;
+		delta = 0;
+	}
+	else if (delta > TIMER_WHEEL_SPAN) {
+		expiry = now + TIMER_WHEEL_SPAN;
+		delta = TIMER_WHEEL_SPAN;
+	}
+	while (level < TIMER_WHEEL_LEVELS - 1 && delta >= (1U << ((level + 1) * TIMER_WHEEL_BITS)))
+		level++;
+	
+	slot = &g_timer_wheel[level][TIMER_WHEEL_INDEX(expiry, level)];
+	node->mp_prev = NULL;
+	node->mp_next = *slot;
+	if (*slot != NULL)
+		(*slot)->mp_prev = node;
+	*slot = node;
+	node->mpp_slot = slot;
+}
+
+/**
+ * Puts a timer node on the wheel to expire delay ticks from now
+ * PRE: interrupts are disabled
+ */
+void timer_arm(TIMER_NODE *node, int delay) {
+	node->m_expiry = timer_now() + delay;
+	timer_insert(node);
+}
+
+/**
+ * Puts a timer node on the wheel to expire at its m_expiry
+ * PRE: interrupts are disabled
+ */
+void timer_insert(TIMER_NODE *node) {
+	g_wheel_count++;
+#ifdef TIMER_TICKLESS
+	// an empty wheel sets no deadline, so g_wheel_now is stale by however long it sat idle
+	if (g_wheel_count == 1)
+		g_wheel_now = timer_now();
+	timer_wheel_insert(node, g_wheel_now);
+	// the new node may be due before the deadline the timer is set for
+	timer_program_next();
+#else
+	timer_wheel_insert(node, g_timer_count);
+#endif
+}
+
+/**
+ * Starts a timer that sends the caller a message of the given type delay ticks from now,
+ * then every period ticks counted from the previous deadline so that it does not drift
+ * The message is a signal whose value is the tick of the deadline it stands for
+ * Returns a handle for cancel_timer(), or -1 if an argument is negative or every timer node is in use
+ */
+int k_set_timer(int type, int delay, int period) {
+	TIMER_NODE *node;
+	if (delay < 0 || period < 0)
+		return RTX_ERR;
+	
+	__disable_irq();
+	node = gp_timer_free;
+	if (node == NULL) {
+		__enable_irq();
+		return RTX_ERR;
+	}
+	gp_timer_free = node->mp_next;
+	
+	node->mp_env = NULL;
+	node->mp_pcb = NULL;
+	node->m_period = period;
+	node->m_msg_type = type;
+	node->m_owner = k_get_current_pid();
+	timer_arm(node, delay);
+	__enable_irq();
+	return TIMER_HANDLE(node - g_timer_nodes, node->m_gen);
+}
+
+/**
+ * Stops a timer of the calling process, messages it already sent stay in the mailbox
+ * Returns -1 if the handle is not a running timer of the caller, 0 otherwise
+ */
+int k_cancel_timer(int handle) {
+	TIMER_NODE *node;
+	if (handle < 0 || TIMER_HANDLE_INDEX(handle) >= NUM_TIMER_NODES)
+		return RTX_ERR;
+	node = &g_timer_nodes[TIMER_HANDLE_INDEX(handle)];
+	
+	__disable_irq();
+	if (!TIMER_IS_HANDLE(node) || node->m_gen != TIMER_HANDLE_GEN(handle)
+		|| node->m_owner != k_get_current_pid() || node->mpp_slot == NULL) {
+		__enable_irq();
+		return RTX_ERR;
+	}
+	timer_cancel(node);
+	timer_node_free(node);
+	__enable_irq();
+	return RTX_OK;
+}
+
+/**
+ * Blocks the calling process for ms ticks in BLOCKED_ON_TIMER
+ * It waits on the timer node of its PCB, so neither the heap nor its mailbox is touched
+ * Returns -1 if ms is negative or the caller is an i-process, 0 otherwise
+ */
+int k_sleep_ms(int ms) {
+	PCB *p_pcb = k_get_current_process();
+	if (ms < 0 || g_iproc_pid != -1)
+		return RTX_ERR;
+	if (ms == 0)
+		return k_release_processor();
+	
+	__disable_irq();
+	p_pcb->m_timer_expired = 0;
+	timer_arm(&(p_pcb->m_timer), ms);
+	while (!p_pcb->m_timer_expired) {
+		p_pcb->m_state = BLOCKED_ON_TIMER;
+		__enable_irq();
+		k_release_processor();
+		__disable_irq();
+	}
+	__enable_irq();
+	return RTX_OK;
+}
+
+/**
+ * Sends the owner of an expired set_timer() node its message, then puts a periodic
+ * node back on the wheel one period after the deadline it stands for or frees a one shot node
+ * PRE: interrupts are disabled
+ */
+void timer_fire(TIMER_NODE *node) {
+	k_send_signal(node->m_owner, node->m_msg_type, node->m_expiry);
+	__disable_irq();
+	if (node->m_period == 0) {
+		timer_node_free(node);
+		return;
+	}
+	node->m_expiry += node->m_period;
+	timer_insert(node);
+}
+
+/**
+ * Takes a timer node off the wheel, if it is on it
+ * PRE: interrupts are disabled
+ */
+void timer_cancel(TIMER_NODE *node) {
+	if (node->mpp_slot == NULL)
+		return;
+	if (node->mp_prev == NULL)
+		*(node->mpp_slot) = node->mp_next;
+	else
+		node->mp_prev->mp_next = node->mp_next;
+	if (node->mp_next != NULL)
+		node->mp_next->mp_prev = node->mp_prev;
+	node->mp_next = NULL;
+	node->mpp_slot = NULL;
+	g_wheel_count--;
+}
+
+/**
+ * Re-inserts the upper level slots that come up at tick now one level down
+ * and takes the level 0 slot of now
+ * Returns the nodes due at now linked through mp_next, NULL if there are none
+ * PRE: interrupts are disabled
+ */
+TIMER_NODE *timer_wheel_tick(U32 now) {
+	TIMER_NODE *due;
+	TIMER_NODE *cur;
+	int level;
+	
+	// level n+1 comes up when the index of level n wraps to 0
+	for (level = 1; level < TIMER_WHEEL_LEVELS && TIMER_WHEEL_INDEX(now, level - 1) == 0; level++) {
+		TIMER_NODE **slot = &g_timer_wheel[level][TIMER_WHEEL_INDEX(now, level)];
+		cur = *slot;
+		*slot = NULL;
+		while (cur != NULL) {
+			TIMER_NODE *next = cur->mp_next;
+			timer_wheel_insert(cur, now);
+			cur = next;
+		}
+	}
+	
+	due = g_timer_wheel[0][TIMER_WHEEL_INDEX(now, 0)];
+	g_timer_wheel[0][TIMER_WHEEL_INDEX(now, 0)] = NULL;
+	for (cur = due; cur != NULL; cur = cur->mp_next) {
+		cur->mpp_slot = NULL;
+		g_wheel_count--;
+	}
+	return due;
+}
+
+#ifdef TIMER_TICKLESS
+/**
+ * Finds the first tick from now on at which the wheel has a node to expire or a slot to cascade
+ * Returns the distance to that tick, or TIMER_NO_DEADLINE if the wheel is empty
+ * PRE: interrupts are disabled
+ */
+U32 timer_wheel_next(U32 now) {
+	U32 best = TIMER_NO_DEADLINE;
+	U32 tick;
+	int level, i;
+	
+	for (i = 0; i < TIMER_WHEEL_SLOTS; i++) {
+		if (g_timer_wheel[0][TIMER_WHEEL_INDEX(now + i, 0)] != NULL) {
+			best = i;
+			break;
+		}
+	}
+	for (level = 1; level < TIMER_WHEEL_LEVELS; level++) {
+		U32 span = 1U << (level * TIMER_WHEEL_BITS);
+		// the first tick at or after now where the slots of this level come up
+		tick = (now + span - 1) & ~(span - 1);
+		for (i = 0; i < TIMER_WHEEL_SLOTS && tick - now < best; i++, tick += span) {
+			if (g_timer_wheel[level][TIMER_WHEEL_INDEX(tick, level)] != NULL) {
+				best = tick - now;
+				break;
+			}
+		}
+	}
+	return best;
+}
+
+/**
+ * Sets the timer interrupt for the first tick the wheel has work at
+ * PRE: interrupts are disabled
+ */
+void timer_program_next(void) {
+	U32 next = timer_wheel_next(g_wheel_now);
+	if (next == TIMER_NO_DEADLINE)
+		timer_clear_deadline();
+	else
+		timer_set_deadline(g_wheel_now + next);
+}
+#endif
+
+/**
+ * Runs the wheel up to the current tick
+ * Tickless, the wheel jumps over the ticks where it has nothing to do
+ * Returns the nodes due by now linked through mp_next, NULL if there are none
+ * PRE: interrupts are disabled
+ */
+TIMER_NODE *timer_expire(void) {
+#ifdef TIMER_TICKLESS
+	U32 now = timer_now();
+	TIMER_NODE *due = NULL;
+	TIMER_NODE **p_last = &due;
+	
+	while ((int)(now - g_wheel_now) >= 0) {
+		U32 next = timer_wheel_next(g_wheel_now);
+		if (next == TIMER_NO_DEADLINE || next > now - g_wheel_now) {
+			g_wheel_now = now + 1;
+			break;
+		}
+		g_wheel_now += next;
+		*p_last = timer_wheel_tick(g_wheel_now);
+		while (*p_last != NULL)
+			p_last = &((*p_last)->mp_next);
+		g_wheel_now++;
+	}
+	return due;
+#else
+	return timer_wheel_tick(g_timer_count);
+#endif
+}
@@ -0,0 +1,82 @@
+/**
+ * @file:   k_timer.h
+ * @brief:  kernel timer wheel and timer node header file
+ */
+
+#ifndef K_TIMER_H_
+#define K_TIMER_H_
+
+#include "k_rtx.h"
+
+/* ----- Definitions ----- */
+/*
+  delayed_send() and set_timer() share the timer nodes, receive_message_timeout()
+  and sleep_ms() wait on the node in the PCB and never take one. Delayed messages
+  are capped at NUM_DELAYED_MSGS, which leaves every process room for a couple of
+  running timers, so the wall clock still gets its timer when the others flood
+  the pool with delayed sends.
+  Handles carry the node index in 8 bits, keep NUM_TIMER_NODES at or below 256.
+*/
+#define TIMERS_PER_PROC 2
+#define NUM_DELAYED_MSGS 32
+#define NUM_TIMER_NODES (NUM_PROCS * TIMERS_PER_PROC + NUM_DELAYED_MSGS)
+
+/*
+  Hierarchical timing wheel: level 0 has one slot per tick and every level
+  above it has slots TIMER_WHEEL_SLOTS times as coarse. Nodes of an upper
+  level are re-inserted one level down when its slot comes up (cascading).
+*/
+#define TIMER_WHEEL_LEVELS 4
+#define TIMER_WHEEL_BITS 6
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_MASK (TIMER_WHEEL_SLOTS - 1)
+/* farthest a node is placed ahead, later expiries cascade down from the last slot until due */
+#define TIMER_WHEEL_SPAN ((1U << (TIMER_WHEEL_LEVELS * TIMER_WHEEL_BITS)) - 1)
+
+/* slot of the wheel level that an expiry falls into */
+#define TIMER_WHEEL_INDEX(expiry, level) (((expiry) >> ((level) * TIMER_WHEEL_BITS)) & TIMER_WHEEL_MASK)
+
+#define TIMER_NO_DEADLINE 0xFFFFFFFF	/* distance to the next deadline of an empty wheel */
+
+/* set_timer() handles carry the node index and its generation */
+#define TIMER_HANDLE(index, gen) (((gen) << 8) | (index))
+#define TIMER_HANDLE_INDEX(handle) ((handle) & 0xFF)
+#define TIMER_HANDLE_GEN(handle) (((handle) >> 8) & 0xFF)
+
+/* whether a node belongs to set_timer() rather than a delayed message or a timed receive */
+#define TIMER_IS_HANDLE(node) ((node)->mp_env == NULL && (node)->mp_pcb == NULL)
+
+extern volatile U32 g_timer_count;
+
+#ifndef TIMER_TICKLESS
+	/* current tick, timer.c provides it from the hardware counter when tickless */
+	#define timer_now() (g_timer_count)
+#endif
+
+/* sets up the free list of timer nodes and empties the wheel */
+void timer_nodes_init(void);
+
+/* puts an expired delayed message node back on the free list, PRE: interrupts are disabled */
+void timer_node_free(TIMER_NODE *node);
+
+/* puts a timer node on the wheel to expire delay ticks from now, PRE: interrupts are disabled */
+void timer_arm(TIMER_NODE *node, int delay);
+
+/* puts a timer node on the wheel to expire at its m_expiry, PRE: interrupts are disabled */
+void timer_insert(TIMER_NODE *node);
+
+/* takes a timer node back before it expires, PRE: interrupts are disabled */
+void timer_cancel(TIMER_NODE *node);
+
+/* sends the owner of an expired set_timer() node its message and re-arms a periodic one, PRE: interrupts are disabled */
+void timer_fire(TIMER_NODE *node);
+
+/* moves the wheel up to the current tick and returns the nodes due by then, PRE: interrupts are disabled */
+TIMER_NODE *timer_expire(void);
+
+#ifdef TIMER_TICKLESS
+/* sets the timer interrupt for the earliest wheel deadline, PRE: interrupts are disabled */
+void timer_program_next(void);
+#endif
+
+#endif /* K_TIMER_H_ */
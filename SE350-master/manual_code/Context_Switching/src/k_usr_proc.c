@@ -9,6 +9,7 @@ void stress_test_a(void){
 	ENVELOPE *msg = (ENVELOPE *)request_memory_block();
 	char* command; 
 	msg->message_type = MSG_COMMAND_REGISTRATION;
+	msg->msg_prio = MSG_PRIO_HIGH;
 	msg->sender_pid = STRESS_TEST_A_PID;
 	msg->destination_pid = KCD_PID;
 	set_message(msg, "%Z" + '\0', 3*sizeof(char));
@@ -16,7 +17,7 @@ void stress_test_a(void){
 	
 	while(1) {
 		msg = (ENVELOPE*) receive_message(NULL);
-		command = (char*) msg->message;
+		command = (char*) msg_payload(msg);
 		if ((command[0] == '%')&&(command[1] == 'Z'))
 		{
 			release_memory_block(msg);
@@ -29,13 +30,10 @@ void stress_test_a(void){
 	}
 	num = 0;
 	while(1) {
-		msg = (ENVELOPE *)request_memory_block();
-		msg->message_type = MSG_COUNT_REPORT;
-		msg->sender_pid = STRESS_TEST_A_PID;
-		msg->destination_pid = STRESS_TEST_B_PID;
-		msg->message = (void*) num;
-		send_message(STRESS_TEST_B_PID, msg);	
-		num += 1;
+		// the count is the whole payload, so it travels without a memory block
+		// and is sent again if every signal envelope is in flight
+		if (send_signal(STRESS_TEST_B_PID, MSG_COUNT_REPORT, num) == RTX_OK)
+			num += 1;
 		release_processor();
 	}
 }
@@ -45,52 +43,30 @@ void stress_test_b(void){
 		ENVELOPE* msg= receive_message(NULL);
 		msg->sender_pid = STRESS_TEST_B_PID;
 		msg->destination_pid = STRESS_TEST_C_PID;
+		msg->msg_prio = MSG_PRIO_LOW;	// keeps reports behind any more urgent message to C
 		send_message(STRESS_TEST_C_PID, msg);
 	}
 }
 
 void stress_test_c(void){
-	ENV_QUEUE messageQueue;
 	ENVELOPE * p;
-	ENVELOPE * q;
 	
 	while(1) {
-		if(msg_empty(&messageQueue)) {
-			p = receive_message(NULL);
-		} else {
-			p = dequeue_env_queue(&messageQueue);
-		}
+		p = receive_message(NULL);
 		
 		if( p->message_type == MSG_COUNT_REPORT ) {
-			int value = (int)(p->message);
-			non_block_release_memory_block(p);
+			int value = *(int*) msg_payload(p);
 			if(value % 31 == 0) {
 				ENVELOPE * msg;
-				char* message;
-				message = "Process C";
-				message[9] = '\r';
-				message[10] = '\n';
-				message[11] = '\0';
 				msg = request_memory_block();
 				msg->message_type = MSG_CRT_DISPLAY;
 				msg->sender_pid = STRESS_TEST_C_PID;
 				msg->destination_pid = CRT_PID;
-				set_message(msg, message, 12*sizeof(char));
+				sprintf(msg_payload(msg), "Process C\r\n");
+				msg->msg_size = strlen(msg_payload(msg)) + 1;
 				send_message(CRT_PID, msg);	
-				/*hibernate for 10s*/
-				q=(ENVELOPE *) request_memory_block();
-				q->message_type=MSG_WAKEUP10;
-				q->sender_pid = STRESS_TEST_C_PID;
-				q->destination_pid = STRESS_TEST_C_PID;
-				delayed_send(STRESS_TEST_C_PID, q, 10000);
-				while (1) {
-					p= receive_message(NULL);
-					if(p->message_type == MSG_WAKEUP10) {
-						break;
-					} else {
-						msg_enqueue(&messageQueue, p);
-					}					
-				}
+				/*hibernate for 10s, count reports keep queuing in the mailbox meanwhile*/
+				sleep_ms(10000);
 			}
 		}
 		release_memory_block(p);
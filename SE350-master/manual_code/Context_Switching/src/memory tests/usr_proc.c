@@ -0,0 +1,179 @@
+/**
+ * @file:   usr_proc.c
+ * @brief:  Test processes for the memory reserve of system processes
+ * @author: Yiqing Huang
+ * @date:   2014/01/17
+ * NOTE: Each process reports to the report process when done and then blocks for good.
+ */
+
+#include "rtx.h"
+#include "k_ipc.h"
+#include "uart_polling.h"
+#include "usr_proc.h"
+#include "printf.h"
+
+#define RESERVE_SYS_PID 1
+#define REPORT_PID 6
+#define NUM_TESTS 1
+#define NUM_TEST_RUNNERS 2	/* processes that send TEST_MSG_DONE */
+
+/* message types of the tests, clear of the ones the system processes use */
+#define TEST_MSG_DONE 21
+#define TEST_MSG_START 24
+
+/* initialization table item */
+PROC_INIT g_test_procs[NUM_TEST_PROCS];
+int passed = 0;
+
+int g_filling = 1;	/* the filler keeps taking blocks while set */
+int g_reserve_armed = 0;	/* set once the filler is blocked on memory */
+int g_filler_woken = 0;	/* set if the filler got a block after that */
+
+void set_test_procs() {
+	g_test_procs[0].m_pid=(U32)(1);
+	g_test_procs[0].m_priority=SYS_PROC;
+	g_test_procs[0].m_stack_size=0x100;
+
+	g_test_procs[1].m_pid=(U32)(2);
+	g_test_procs[1].m_priority=HIGH;
+	g_test_procs[1].m_stack_size=0x100;
+	
+	g_test_procs[2].m_pid=(U32)(3);
+	g_test_procs[2].m_priority=LOW;
+	g_test_procs[2].m_stack_size=0x100;
+
+	g_test_procs[3].m_pid=(U32)(4);
+	g_test_procs[3].m_priority=LOW;
+	g_test_procs[3].m_stack_size=0x100;
+	
+	g_test_procs[4].m_pid=(U32)(5);
+	g_test_procs[4].m_priority=LOW;
+	g_test_procs[4].m_stack_size=0x100;
+	
+	g_test_procs[5].m_pid=(U32)(6);
+	g_test_procs[5].m_priority=LOWEST;
+	g_test_procs[5].m_stack_size=0x100;
+  
+	g_test_procs[0].mpf_start_pc = &reserve_sys_proc;
+	g_test_procs[1].mpf_start_pc = &reserve_filler;
+	g_test_procs[2].mpf_start_pc = &reserve_trigger;
+	g_test_procs[3].mpf_start_pc = &idle_test_proc;
+	g_test_procs[4].mpf_start_pc = &idle_test_proc;
+	g_test_procs[5].mpf_start_pc = &report_proc;
+}
+
+void test_result(int test, int ok)
+{
+	char line[32];
+	sprintf(line, "G009_test: test %d %s\n\r", test, ok ? "OK" : "FAIL");
+	uart0_put_string(line);
+	if (ok)
+		passed++;
+}
+
+/*
+
+Expected behaviour:
+process 2 takes every block a user process may take, mailing each one to process 1 so
+they can be given back later, and blocks on memory once only the reserve is left
+process 3 then starts process 1, a system process that takes a reserve block and releases it
+the block goes back on the free list rather than to process 2, which stays blocked
+process 1 then releases what process 2 mailed it, which lets process 2 finish
+
+*/
+
+// Assuming pid 1
+void reserve_sys_proc(void)
+{
+	ENVELOPE* message;
+	void* blk;
+	void* again;
+	int ok;
+	
+	release_memory_block(receive_message_filtered(MSG_TYPE_BIT(TEST_MSG_START), MSG_SENDER_ANY));
+	blk = request_memory_block();
+	release_memory_block(blk);
+	// a process readied by the release would run while this one sleeps
+	sleep_ms(20);
+	ok = !g_filler_woken;
+	// the free list hands out the block it got back first
+	again = request_memory_block();
+	ok = ok && again == blk;
+	release_memory_block(again);
+	test_result(1, ok);
+	
+	g_filling = 0;
+	while ((message = (ENVELOPE*) receive_message_timeout(NULL, 0)) != NULL)
+		release_memory_block(message);
+	test_done();
+}
+
+// Assuming pid 2
+void reserve_filler(void)
+{
+	void* blk;
+	while (1)
+	{
+		blk = request_memory_block();
+		if (g_reserve_armed)
+			g_filler_woken = 1;
+		if (!g_filling) {
+			release_memory_block(blk);
+			break;
+		}
+		send_message(RESERVE_SYS_PID, blk);
+	}
+	test_done();
+}
+
+// Assuming pid 3, runs once the filler is blocked on memory
+void reserve_trigger(void)
+{
+	g_reserve_armed = 1;
+	send_signal(RESERVE_SYS_PID, TEST_MSG_START, 0);
+	while (1)
+	{
+		release_memory_block(receive_message(NULL));
+	}
+}
+
+void idle_test_proc(void)
+{
+	while (1)
+	{
+		release_memory_block(receive_message(NULL));
+	}
+}
+
+/**
+ * Tells the report process this test process is finished and blocks for good
+ */
+void test_done(void)
+{
+	send_signal(REPORT_PID, TEST_MSG_DONE, 0);
+	while (1)
+	{
+		release_memory_block(receive_message(NULL));
+	}
+}
+
+// Assuming pid 6
+void report_proc(void)
+{
+	char line[48];
+	int done = 0;
+	while (done < NUM_TEST_RUNNERS) {
+		ENVELOPE* message = (ENVELOPE*) receive_message(NULL);
+		if (message->message_type == TEST_MSG_DONE)
+			done++;
+		release_memory_block(message);
+	}
+	sprintf(line, "G009_test: %d/%d tests OK\n\r", passed, NUM_TESTS);
+	uart0_put_string(line);
+	sprintf(line, "G009_test: %d/%d tests FAILED\n\r", NUM_TESTS - passed, NUM_TESTS);
+	uart0_put_string(line);
+	while (1)
+	{
+		release_memory_block(receive_message(NULL));
+	}
+}
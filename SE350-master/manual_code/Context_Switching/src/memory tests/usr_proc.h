@@ -0,0 +1,18 @@
+/**
+ * @file:   usr_proc.h
+ * @brief:  Memory test processes header file
+ * @author: Yiqing Huang
+ * @date:   2014/01/17
+ */
+ 
+#ifndef USR_PROC_H_
+#define USR_PROC_H
+
+void set_test_procs(void);
+void reserve_sys_proc(void);
+void reserve_filler(void);
+void reserve_trigger(void);
+void idle_test_proc(void);
+void report_proc(void);
+void test_done(void);
+#endif /* USR_PROC_H_ */
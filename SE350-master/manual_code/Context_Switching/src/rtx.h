@@ -5,17 +5,23 @@
 #ifndef RTX_H_
 #define RTX_H_
 
+#include <stdint.h>
+
 /* ----- Definitations ----- */
 #define RTX_ERR -1
 #define NULL 0
 #define NUM_TEST_PROCS 6
+/* Number of user priority levels (HIGH..LOWEST), must match the kernel */
+#ifndef NUM_USR_PRIORITIES
+#define NUM_USR_PRIORITIES 4
+#endif
 /* Process Priority. The bigger the number is, the lower the priority is*/
 #define HIGH    0
 #define MEDIUM  1
 #define LOW     2
-#define LOWEST  3
-#define NULL_PROC 4 /* the hidden priority for the null process only */
-#define SYS_PROC 5 /* special priority for system processes KCD, CRT, and Wall Clock (and set priority process)*/
+#define LOWEST  (NUM_USR_PRIORITIES - 1)
+#define NULL_PROC NUM_USR_PRIORITIES /* the hidden priority for the null process only */
+#define SYS_PROC (NUM_USR_PRIORITIES + 1) /* special priority for system processes KCD, CRT, and Wall Clock (and set priority process)*/
 
 /* ----- Types ----- */
 typedef unsigned int U32;
@@ -27,39 +33,70 @@ typedef struct proc_init
 	int m_priority;         /* initial priority */ 
 	int m_stack_size;       /* size of stack in words */
 	void (*mpf_start_pc) ();/* entry point of the process */    
+	int m_mem_quota;        /* most memory blocks owned at once, 0 for no limit */
+	int m_mbox_limit;       /* most messages queued in the mailbox, 0 for no limit */
 } PROC_INIT;
 
 /* ----- RTX User API ----- */
 #define __SVC_0  __svc_indirect(0)
 
 extern void k_rtx_init(void);
-#define rtx_init() _rtx_init((U32)k_rtx_init)
+#define rtx_init() _rtx_init((U32)(uintptr_t)k_rtx_init)
 extern void __SVC_0 _rtx_init(U32 p_func);
 
 extern int k_release_processor(void);
-#define release_processor() _release_processor((U32)k_release_processor)
+#define release_processor() _release_processor((U32)(uintptr_t)k_release_processor)
 extern int __SVC_0 _release_processor(U32 p_func);
 
 extern void *k_request_memory_block(void);
-#define request_memory_block() _request_memory_block((U32)k_request_memory_block)
+#define request_memory_block() _request_memory_block((U32)(uintptr_t)k_request_memory_block)
 extern void *_request_memory_block(U32 p_func) __SVC_0;
 /* __SVC_0 can also be put at the end of the function declaration */
 
+extern void *k_request_memory_block_sized(U32 size_b);
+#define request_memory_block_sized(size_b) _request_memory_block_sized((U32)(uintptr_t)k_request_memory_block_sized, size_b)
+extern void *_request_memory_block_sized(U32 p_func, U32 size_b) __SVC_0;
+
 extern int k_release_memory_block(void *);
-#define release_memory_block(p_mem_blk) _release_memory_block((U32)k_release_memory_block, p_mem_blk)
+#define release_memory_block(p_mem_blk) _release_memory_block((U32)(uintptr_t)k_release_memory_block, p_mem_blk)
 extern int _release_memory_block(U32 p_func, void *p_mem_blk) __SVC_0;
 
+/* Served from the calling process's magazine without trapping when possible */
+extern void *cached_request_memory_block(void);
+extern int cached_release_memory_block(void *p_mem_blk);
+
 extern int k_get_process_priority(int pid);
-#define get_process_priority(pid) _get_process_priority((U32)k_get_process_priority, pid)
+#define get_process_priority(pid) _get_process_priority((U32)(uintptr_t)k_get_process_priority, pid)
 extern int _get_process_priority(U32 p_func, int pid) __SVC_0;
 /* __SVC_0 can also be put at the end of the function declaration */
 
+extern int k_get_stack_high_water(int pid);
+#define get_stack_high_water(pid) _get_stack_high_water((U32)(uintptr_t)k_get_stack_high_water, pid)
+extern int _get_stack_high_water(U32 p_func, int pid) __SVC_0;
+
 extern int k_set_process_priority(int pid, int prio);
-#define set_process_priority(pid, prio) _set_process_priority((U32)k_set_process_priority, pid, prio)
+#define set_process_priority(pid, prio) _set_process_priority((U32)(uintptr_t)k_set_process_priority, pid, prio)
 extern int _set_process_priority(U32 p_func, int pid, int prio) __SVC_0;
 
+/* Sends env to process_id after delay ms, RTX_ERR for a bad pid or delay, an env the caller does not own
+   or when every timer node is in use; env stays with the caller on RTX_ERR */
 extern int k_delayed_send(int process_id, void * env, int delay);
-#define delayed_send(pid, env, delay) _delayed_send((U32)k_delayed_send, pid, env, delay)
+#define delayed_send(pid, env, delay) _delayed_send((U32)(uintptr_t)k_delayed_send, pid, env, delay)
 extern int _delayed_send(U32 p_func, int target_pid, void* message_envelope, int delay) __SVC_0;
 
+/* Sends the caller a message of the given type after delay ms and then every period ms (0 for once),
+   RTX_ERR when every timer node is in use */
+extern int k_set_timer(int type, int delay, int period);
+#define set_timer(type, delay, period) _set_timer((U32)(uintptr_t)k_set_timer, type, delay, period)
+extern int _set_timer(U32 p_func, int type, int delay, int period) __SVC_0;
+
+extern int k_cancel_timer(int handle);
+#define cancel_timer(handle) _cancel_timer((U32)(uintptr_t)k_cancel_timer, handle)
+extern int _cancel_timer(U32 p_func, int handle) __SVC_0;
+
+/* Blocks the caller for ms ms without using a memory block or its mailbox */
+extern int k_sleep_ms(int ms);
+#define sleep_ms(ms) _sleep_ms((U32)(uintptr_t)k_sleep_ms, ms)
+extern int _sleep_ms(U32 p_func, int ms) __SVC_0;
+
 #endif /* !RTX_H_ */
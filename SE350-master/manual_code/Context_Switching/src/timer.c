@@ -11,7 +11,7 @@
 
 #define BIT(X) (1<<X)
 
-volatile uint32_t g_timer_count = 0; // increment every 1 ms
+volatile uint32_t g_timer_count = 0; // increment every 1 ms, refreshed from TC on each interrupt when tickless
 volatile uint32_t* function_timer;
 /**
  * @brief: initialize timer. Only timer 0 is supported
@@ -58,6 +58,15 @@ uint32_t timer_init(uint8_t n_timer)
 	-----------------------------------------------------
 	*/
 
+#ifdef TIMER_TICKLESS
+	/* Tickless: TC counts milliseconds and never resets,
+	   MR0 is moved to the next deadline by timer_set_deadline()
+	   (25000 - 1 + 1)*(1/25) * 10^(-6) s = 10^(-3) s = 1 ms
+	*/
+	pTimer->PR = 24999;
+	pTimer->MR0 = 0;
+	pTimer->MCR = 0;
+#else
 	/* Step 4.1: Prescale Register PR setting 
 	   CCLK = 100 MHZ, PCLK = CCLK/4 = 25 MHZ
 	   2*(12499 + 1)*(1/25) * 10^(-6) s = 10^(-3) s = 1 ms
@@ -75,6 +84,7 @@ uint32_t timer_init(uint8_t n_timer)
 	   Reset on MR0: Reset TC if MR0 mathches it.
 	*/
 	pTimer->MCR = BIT(0) | BIT(1);
+#endif
 
 	g_timer_count = 0;
 
@@ -101,6 +111,36 @@ uint32_t timer_init(uint8_t n_timer)
 }
 
 
+#ifdef TIMER_TICKLESS
+/**
+ * @brief: milliseconds since timer_init(0), read from the free-running TC
+ */
+uint32_t timer_now(void)
+{
+	return LPC_TIM0->TC;
+}
+
+/**
+ * @brief: interrupt when TC reaches tick, or right away if it already has
+ */
+void timer_set_deadline(uint32_t tick)
+{
+	LPC_TIM0->MR0 = tick;
+	LPC_TIM0->MCR = BIT(0);
+	// a match only happens when TC steps onto MR0
+	if ((int)(tick - LPC_TIM0->TC) <= 0)
+		NVIC_SetPendingIRQ(TIMER0_IRQn);
+}
+
+/**
+ * @brief: no timer interrupt until the next timer_set_deadline()
+ */
+void timer_clear_deadline(void)
+{
+	LPC_TIM0->MCR = 0;
+}
+#endif
+
 /**
  * @brief: use CMSIS ISR for TIMER0 IRQ Handler
  * NOTE: This example shows how to save/restore all registers rather than just
@@ -9,4 +9,15 @@
 /* initialize timer n_timer */
 extern uint32_t timer_init ( uint8_t n_timer );
 
+#ifdef TIMER_TICKLESS
+/* current tick of timer 0 */
+extern uint32_t timer_now ( void );
+
+/* timer 0 interrupts at the given tick */
+extern void timer_set_deadline ( uint32_t tick );
+
+/* timer 0 stops interrupting */
+extern void timer_clear_deadline ( void );
+#endif
+
 #endif /* ! _TIMER_H_ */
@@ -0,0 +1,24 @@
+/**
+ * @brief: LPC17xx.h - host stand-in for the CMSIS device header, used by the benchmarks
+ *         in timing analysis to build kernel sources on a PC
+ */
+#ifndef LPC17xx_H_HOST
+#define LPC17xx_H_HOST
+
+#include <stdint.h>
+
+/* one core and no interrupts, so the critical sections are empty */
+#define __disable_irq()
+#define __enable_irq()
+#define __wfi()
+#define __clz(x) ((x) ? (unsigned int) __builtin_clz(x) : 32U)
+#define __get_MSP() 0
+#define __set_MSP(x)
+
+/* SVC wrappers become plain declarations */
+#define __svc_indirect(x)
+
+/* the printf callback of uart_polling.h would clash with the C library's putc() */
+#define putc uart_putc
+
+#endif /* LPC17xx_H_HOST */
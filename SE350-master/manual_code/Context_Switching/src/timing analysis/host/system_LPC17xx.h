@@ -0,0 +1,3 @@
+/**
+ * @brief: system_LPC17xx.h - host stand-in, the benchmarks need nothing from it
+ */
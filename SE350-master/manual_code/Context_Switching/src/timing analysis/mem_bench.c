@@ -0,0 +1,182 @@
+/**
+ * @file:   mem_bench.c
+ * @brief:  Host benchmark of the free list allocator in k_memory.c against the
+ *          byte map scan it replaced
+ * NOTE: Build and run on a PC from this directory:
+ *       gcc -O2 -Ihost -I.. -o mem_bench mem_bench.c && ./mem_bench
+ *
+ * Each operation requests one block and releases it again while some blocks
+ * stay allocated. The held blocks are the lowest ones, so the scan has to walk
+ * past all of them. The free list is measured bare through mem_pool_pop() and
+ * mem_pool_push(), through k_request_memory_block() and k_release_memory_block()
+ * with the owner, quota and reserve bookkeeping, and through the magazine of
+ * cached_request_memory_block() and cached_release_memory_block().
+ */
+
+#include <LPC17xx.h>
+#include "../k_memory.c"
+#include <time.h>
+
+#undef printf	/* printf.h maps it to the target's tfp_printf */
+#undef sprintf
+int printf(const char *fmt, ...);	/* stdio.h clashes with remove() in k_rtx.h */
+
+#define NUM_BENCH_BLKS 128
+#define NUM_BENCH_OPS 10000000
+#define NUM_BENCH_RUNS 5	/* the fastest run is reported, the others carry the noise of the host */
+
+/* what k_memory.c needs from the rest of the kernel */
+unsigned int Image$$RW_IRAM1$$ZI$$Limit;
+PRIO_QUEUE blocked_on_memory_queue;
+PROC_INIT g_proc_table[NUM_PROCS];
+PCB **gp_pcbs;
+PCB g_bench_pcb;
+PCB *gp_bench_pcbs[NUM_PROCS];
+int g_iproc_pid = -1;
+U32 g_input_dropped;
+PCB *k_get_current_process(void) { return &g_bench_pcb; }
+U32 k_get_current_pid(void) { return g_bench_pcb.m_pid; }
+int k_release_processor(void) { return RTX_OK; }
+void k_block_current_processs(void) {}
+PCB *k_find_blocked_on_memory(int pool) { return NULL; }
+void k_ready_blocked_on_memory(PCB *pcb) {}
+void k_ready_process(int pid) {}
+int prio_empty(PRIO_QUEUE *pq) { return 1; }
+int msg_signal_free(void* message_envelope) { return 0; }
+void tfp_sprintf(char* s, char *fmt, ...) {}
+int uart_put_string(int n_uart, unsigned char *s) { return 0; }
+void *_request_memory_block(U32 p_func) { return k_request_memory_block(); }
+int _release_memory_block(U32 p_func, void *p_mem_blk) { return k_release_memory_block(p_mem_blk); }
+
+U32 g_bench_heap[NUM_BENCH_BLKS * MEMORY_BLOCK_SIZE / sizeof(U32)];
+U8 g_bench_map[NUM_BENCH_BLKS];
+void *g_bench_held[NUM_BENCH_BLKS];
+
+/* ----- the byte map scan, as k_memory.c kept the heap before the free list ----- */
+U8* beginHeap;
+U8* beginMemMap;	/* one byte per block, 1 while the block is allocated */
+
+int mem_scan_empty(void) {
+	int i;
+	for (i = 0;i < NUM_BENCH_BLKS; i++)
+	{
+		if (*(beginMemMap + i) == 0)
+		{
+			return 0;
+		}
+	}
+	return 1;
+}
+
+void *scan_request_memory_block(void) {
+	U8* rVoid = beginHeap;
+	int i;
+	while(mem_scan_empty() == 1)
+	{
+		k_block_current_processs();
+		k_release_processor();
+	}
+	
+	for (i = 0; i < NUM_BENCH_BLKS; i++)
+	{
+		if (*(beginMemMap + i) == 0)
+		{
+			*(beginMemMap + i) = 1;
+			break;
+		}
+	}
+	return (void*) (rVoid+i*MEMORY_BLOCK_SIZE);
+}
+
+int scan_release_memory_block(void *p_mem_blk) {
+	if (((U8*) p_mem_blk < beginHeap)||((U8*) p_mem_blk >= beginHeap + NUM_BENCH_BLKS*MEMORY_BLOCK_SIZE))
+		return RTX_ERR;
+	if (((U8*)p_mem_blk - beginHeap)%MEMORY_BLOCK_SIZE != 0)
+		return RTX_ERR;
+	*(beginMemMap + ((U8*)p_mem_blk - beginHeap)/MEMORY_BLOCK_SIZE) = 0;
+	return RTX_OK;
+}
+
+/* ----- the free list alone, without the bookkeeping of the request and release calls ----- */
+void *list_request_memory_block(void) {
+	return mem_pool_pop(&g_mem_pools[MEM_POOL_DEFAULT], 1);
+}
+
+int list_release_memory_block(void *p_mem_blk) {
+	mem_pool_push(&g_mem_pools[MEM_POOL_DEFAULT], (MEM_BLK *) p_mem_blk);
+	return RTX_OK;
+}
+
+/**
+ * Empties the heap, then allocates the held lowest blocks with the allocator under test
+ */
+void bench_setup(int held, void *(*request)(void)) {
+	int i;
+	MEM_POOL *pool = &g_mem_pools[MEM_POOL_DEFAULT];
+
+	for (i = 0; i < NUM_PROCS; i++)
+		gp_bench_pcbs[i] = &g_bench_pcb;
+	gp_pcbs = gp_bench_pcbs;
+	g_bench_pcb.m_pid = 1;
+	g_bench_pcb.m_priority = MEDIUM;
+	g_bench_pcb.m_mem_quota = 0;
+	g_bench_pcb.m_blks_held = 0;
+	g_bench_pcb.m_mag_count = 0;
+
+	pool->m_blk_size = MEMORY_BLOCK_SIZE;
+	pool->m_num_blks = NUM_BENCH_BLKS;
+	pool->mp_heap = (U8 *) g_bench_heap;
+	pool->mp_map = g_bench_map;
+	mem_pool_init(pool);
+
+	beginHeap = (U8 *) g_bench_heap;
+	beginMemMap = g_bench_map;
+	if (request == scan_request_memory_block)
+		for (i = 0; i < NUM_BENCH_BLKS; i++)
+			beginMemMap[i] = 0;
+
+	for (i = 0; i < held; i++)
+		g_bench_held[i] = request();
+}
+
+/**
+ * Returns the nanoseconds per request and release pair of one run
+ */
+double bench_ops(int held, void *(*request)(void), int (*release)(void *)) {
+	clock_t start;
+	int i;
+	bench_setup(held, request);
+	start = clock();
+	for (i = 0; i < NUM_BENCH_OPS; i++)
+		release(request());
+	return (double)(clock() - start) * 1e9 / CLOCKS_PER_SEC / NUM_BENCH_OPS;
+}
+
+/**
+ * Returns the nanoseconds per request and release pair of the fastest of NUM_BENCH_RUNS runs
+ */
+double bench_best(int held, void *(*request)(void), int (*release)(void *)) {
+	double best = bench_ops(held, request, release);
+	int i;
+	for (i = 1; i < NUM_BENCH_RUNS; i++) {
+		double t = bench_ops(held, request, release);
+		if (t < best)
+			best = t;
+	}
+	return best;
+}
+
+int main(void) {
+	int held[] = {0, NUM_BENCH_BLKS / 2, NUM_BENCH_BLKS - MEM_RESERVE_BLKS - 1};
+	int i;
+	printf("%d blocks, %d request/release pairs, ns per pair, best of %d runs\n", NUM_BENCH_BLKS, NUM_BENCH_OPS, NUM_BENCH_RUNS);
+	printf("%8s %10s %10s %10s %10s\n", "held", "scan", "pop/push", "request", "magazine");
+	for (i = 0; i < (int)(sizeof(held) / sizeof(held[0])); i++) {
+		double scan = bench_best(held[i], scan_request_memory_block, scan_release_memory_block);
+		double list = bench_best(held[i], list_request_memory_block, list_release_memory_block);
+		double kernel = bench_best(held[i], k_request_memory_block, k_release_memory_block);
+		double mag = bench_best(held[i], cached_request_memory_block, cached_release_memory_block);
+		printf("%8d %10.1f %10.1f %10.1f %10.1f\n", held[i], scan, list, kernel, mag);
+	}
+	return 0;
+}
@@ -0,0 +1,138 @@
+/**
+ * @file:   sched_bench.c
+ * @brief:  Host benchmark of the bitmap ready queue in k_process.c against the
+ *          per-priority scan it replaced
+ * NOTE: Build and run on a PC from this directory:
+ *       gcc -O2 -Ihost -I.. -o sched_bench sched_bench.c && ./sched_bench
+ *       add -DNUM_USR_PRIORITIES=30 for the largest number of levels
+ *
+ * Each pick takes the next process off the ready queue and puts it back at the
+ * end of its level, which is what scheduler() and k_release_processor() do to a
+ * process that yields. Only the lookup of the highest non-empty level differs.
+ */
+
+#include <LPC17xx.h>
+#include "../k_process.c"
+#include <time.h>
+
+#undef printf	/* printf.h maps it to the target's tfp_printf */
+#undef sprintf
+int printf(const char *fmt, ...);	/* stdio.h clashes with remove() in k_rtx.h */
+
+#define NUM_BENCH_PICKS 20000000
+#define NUM_BENCH_RUNS 5	/* the fastest run is reported, the others carry the noise of the host */
+
+/* what k_process.c needs from the rest of the kernel */
+PROC_INIT g_test_procs[NUM_TEST_PROCS];
+void set_test_procs(void) {}
+void null_proc(void) {}
+void stress_test_a(void) {}
+void stress_test_b(void) {}
+void stress_test_c(void) {}
+void set_priority_proc(void) {}
+void wall_clock_proc(void) {}
+void kcd_proc(void) {}
+void crt_proc(void) {}
+void timer_i_proc(void) {}
+void uart_i_proc(void) {}
+void __rte(void) {}
+void msg_queue_init(ENV_QUEUE* q) {}
+void tfp_sprintf(char* s, char *fmt, ...) {}
+int uart_put_string(int n_uart, unsigned char *s) { return 0; }
+
+PCB g_bench_pcbs[NUM_PROCS];
+QUEUE g_scan_levels[NUM_PRIORITY_LEVELS];
+
+/**
+ * Dequeues the head of the highest non-empty level by checking the levels in turn,
+ * the way scheduler() did before the bitmap
+ * Returns a pointer to the dequeued PCB or NULL if all levels are empty
+ */
+PCB* scan_dequeue(QUEUE *levels) {
+	int i;
+	for (i = 0; i < NUM_PRIORITY_LEVELS; i++){
+		if (!isEmpty(&levels[i])){
+			return dequeue(&levels[i]);
+		}
+	}
+	return NULL;
+}
+
+/**
+ * Readies n processes of the given priority, plus the null process
+ */
+void bench_fill(int prio, int n, int scan) {
+	int i;
+	prio_init(&ready_priority_queue);
+	for (i = 0; i < NUM_PRIORITY_LEVELS; i++) {
+		g_scan_levels[i].head = NULL;
+		g_scan_levels[i].tail = NULL;
+	}
+	for (i = 0; i <= n; i++) {
+		g_bench_pcbs[i].m_pid = i;
+		g_bench_pcbs[i].m_priority = (i == 0) ? NULL_PROC : prio;
+		if (scan)
+			enqueue(&g_scan_levels[PRIO_LEVEL(g_bench_pcbs[i].m_priority)], &g_bench_pcbs[i]);
+		else
+			prio_enqueue(&ready_priority_queue, &g_bench_pcbs[i]);
+	}
+}
+
+/**
+ * Returns the nanoseconds per pick of one run with n processes of priority prio ready
+ */
+double bench_picks(int prio, int n, int scan, U32 *p_sum) {
+	clock_t start;
+	U32 sum = 0;
+	int i;
+	bench_fill(prio, n, scan);
+	start = clock();
+	if (scan) {
+		for (i = 0; i < NUM_BENCH_PICKS; i++) {
+			PCB *p = scan_dequeue(g_scan_levels);
+			sum += p->m_pid;
+			enqueue(&g_scan_levels[PRIO_LEVEL(p->m_priority)], p);
+		}
+	}
+	else {
+		for (i = 0; i < NUM_BENCH_PICKS; i++) {
+			PCB *p = prio_dequeue(&ready_priority_queue);
+			sum += p->m_pid;
+			prio_enqueue(&ready_priority_queue, p);
+		}
+	}
+	*p_sum = sum;
+	return (double)(clock() - start) * 1e9 / CLOCKS_PER_SEC / NUM_BENCH_PICKS;
+}
+
+/**
+ * Returns the nanoseconds per pick of the fastest of NUM_BENCH_RUNS runs
+ */
+double bench_best(int prio, int n, int scan, U32 *p_sum) {
+	double best = bench_picks(prio, n, scan, p_sum);
+	int i;
+	for (i = 1; i < NUM_BENCH_RUNS; i++) {
+		double t = bench_picks(prio, n, scan, p_sum);
+		if (t < best)
+			best = t;
+	}
+	return best;
+}
+
+int main(void) {
+	int prios[] = {SYS_PROC, HIGH, LOWEST, NULL_PROC};
+	char *names[] = {"SYS_PROC", "HIGH", "LOWEST", "null only"};
+	int i;
+	printf("%d levels, %d picks, ns per pick, best of %d runs\n", NUM_PRIORITY_LEVELS, NUM_BENCH_PICKS, NUM_BENCH_RUNS);
+	printf("%10s %10s %10s %8s\n", "ready", "scan", "bitmap", "speedup");
+	for (i = 0; i < 4; i++) {
+		U32 sum_scan, sum_bitmap;
+		int n = (prios[i] == NULL_PROC) ? 0 : 4;
+		double scan = bench_best(prios[i], n, 1, &sum_scan);
+		double bitmap = bench_best(prios[i], n, 0, &sum_bitmap);
+		if (sum_scan != sum_bitmap)
+			printf("mismatch: scan picked %u, bitmap picked %u\n", sum_scan, sum_bitmap);
+		printf("%10s %10.2f %10.2f %7.1fx\n", names[i], scan, bitmap, scan / bitmap);
+	}
+	return 0;
+}
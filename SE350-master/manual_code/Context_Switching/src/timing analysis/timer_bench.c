@@ -0,0 +1,165 @@
+/**
+ * @file:   timer_bench.c
+ * @brief:  Host benchmark of the timing wheel in k_timer.c against the sorted
+ *          timer queue it replaced
+ * NOTE: Build and run on a PC from this directory:
+ *       gcc -O2 -Ihost -I.. -o timer_bench timer_bench.c && ./timer_bench
+ *
+ * Every run keeps n timers in flight. Each tick the due timers are taken off
+ * and re-armed with a new random delay of 1 to MAX_DELAY ticks, the way
+ * delayed_send() and receive_message_timeout() traffic keeps the timer busy.
+ * Both sides run the same delays, so they do the same work apart from the
+ * data structure.
+ */
+
+#include <LPC17xx.h>
+#include "../k_timer.c"
+#include <time.h>
+
+int printf(const char *fmt, ...);	/* stdio.h clashes with remove() in k_rtx.h */
+
+#define MAX_DELAY 5000
+#define NUM_BENCH_TICKS 200000
+#define MAX_BENCH_NODES 1024
+
+/* what k_timer.c needs from the rest of the kernel */
+volatile U32 g_timer_count = 0;
+int g_iproc_pid = -1;
+PCB g_bench_pcb;
+void mem_set_owner(void *p_mem_blk, U32 pid) {}
+int mem_is_owner(void *p_mem_blk, U32 pid) { return 1; }
+U32 k_get_current_pid(void) { return 1; }
+PCB *k_get_current_process(void) { return &g_bench_pcb; }
+int k_release_processor(void) { return RTX_OK; }
+int k_send_signal(int target_pid, int type, U32 value) { return RTX_OK; }
+
+TIMER_NODE g_bench_nodes[MAX_BENCH_NODES];
+U32 g_rand = 1;
+
+U32 bench_rand(void) {
+	g_rand = g_rand * 1103515245 + 12345;
+	return (g_rand >> 8) % MAX_DELAY + 1;
+}
+
+/* ----- the sorted timer queue, as the timer i-process kept it before the wheel ----- */
+TIMER_QUEUE t_queue;
+
+void sorted_insert(TIMER_NODE* node){
+	node->mp_next = NULL;
+	if (t_queue.head == NULL){
+		t_queue.head = node;
+		t_queue.tail = node;
+	}
+	//Only one element currently in the queue
+	else if (t_queue.head == t_queue.tail){
+		if (t_queue.head->m_expiry < node->m_expiry){
+			t_queue.head->mp_next = node;
+			t_queue.tail = node;
+		}
+		else {
+			t_queue.head = node;
+			node->mp_next = t_queue.tail;
+			t_queue.tail->mp_next = NULL;
+		}
+	}
+	else {
+		//Checking bounds for when node expiry is less than all
+		if (node->m_expiry < t_queue.head->m_expiry){
+			node->mp_next = t_queue.head;
+			t_queue.head = node;
+		}
+		//Checking bounds for when node expiry is >= to all
+		else if (node->m_expiry >= t_queue.tail->m_expiry){
+			t_queue.tail->mp_next = node;
+			t_queue.tail = node;
+		}
+		else {
+			TIMER_NODE* cur = t_queue.head;
+			TIMER_NODE* prev = t_queue.head;
+			while ((cur != NULL) && (node->m_expiry >= cur->m_expiry)){
+				prev = cur;
+				cur = cur->mp_next;
+			}
+			prev->mp_next = node;
+			node->mp_next = cur;
+		}
+	}
+}
+
+/**
+ * Runs the sorted queue for NUM_BENCH_TICKS ticks with n timers in flight
+ * Returns the number of timers that fired
+ */
+U32 bench_sorted(int n) {
+	U32 fired = 0;
+	int i;
+	g_rand = 1;
+	g_timer_count = 0;
+	t_queue.head = NULL;
+	t_queue.tail = NULL;
+	for (i = 0; i < n; i++) {
+		g_bench_nodes[i].m_expiry = g_timer_count + bench_rand();
+		sorted_insert(&g_bench_nodes[i]);
+	}
+	for (g_timer_count = 1; g_timer_count <= NUM_BENCH_TICKS; g_timer_count++) {
+		while (t_queue.head != NULL && t_queue.head->m_expiry <= g_timer_count) {
+			TIMER_NODE *node = t_queue.head;
+			t_queue.head = node->mp_next;
+			if (t_queue.head == NULL)
+				t_queue.tail = NULL;
+			fired++;
+			node->m_expiry = g_timer_count + bench_rand();
+			sorted_insert(node);
+		}
+	}
+	return fired;
+}
+
+/**
+ * Runs the timing wheel for NUM_BENCH_TICKS ticks with n timers in flight
+ * Returns the number of timers that fired
+ */
+U32 bench_wheel(int n) {
+	U32 fired = 0;
+	int i;
+	g_rand = 1;
+	g_timer_count = 0;
+	timer_nodes_init();
+	for (i = 0; i < n; i++)
+		timer_arm(&g_bench_nodes[i], bench_rand());
+	for (g_timer_count = 1; g_timer_count <= NUM_BENCH_TICKS; g_timer_count++) {
+		TIMER_NODE *due = timer_expire();
+		while (due != NULL) {
+			TIMER_NODE *node = due;
+			due = node->mp_next;
+			fired++;
+			timer_arm(node, bench_rand());
+		}
+	}
+	return fired;
+}
+
+/**
+ * Returns the nanoseconds per tick of one run
+ */
+double bench_run(U32 (*run)(int), int n, U32 *p_fired) {
+	clock_t start = clock();
+	*p_fired = run(n);
+	return (double)(clock() - start) * 1e9 / CLOCKS_PER_SEC / NUM_BENCH_TICKS;
+}
+
+int main(void) {
+	int sizes[] = {16, 64, 256, 1024};
+	int i;
+	printf("%d ticks, delays 1..%d ticks, ns per tick\n", NUM_BENCH_TICKS, MAX_DELAY);
+	printf("%8s %10s %10s %10s %8s\n", "timers", "fired", "sorted", "wheel", "speedup");
+	for (i = 0; i < (int)(sizeof(sizes) / sizeof(sizes[0])); i++) {
+		U32 fired_sorted, fired_wheel;
+		double sorted = bench_run(bench_sorted, sizes[i], &fired_sorted);
+		double wheel = bench_run(bench_wheel, sizes[i], &fired_wheel);
+		if (fired_sorted != fired_wheel)
+			printf("mismatch: sorted fired %u, wheel fired %u\n", fired_sorted, fired_wheel);
+		printf("%8d %10u %10.1f %10.1f %7.1fx\n", sizes[i], fired_wheel, sorted, wheel, sorted / wheel);
+	}
+	return 0;
+}
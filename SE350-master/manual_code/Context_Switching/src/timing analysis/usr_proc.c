@@ -26,11 +26,11 @@ void * memory_blocks[20];
 
 void set_test_procs() {
 	g_test_procs[0].m_pid=(U32)(1);
-	g_test_procs[0].m_priority=LOW;
+	g_test_procs[0].m_priority=MEDIUM;
 	g_test_procs[0].m_stack_size=0x100;
 
 	g_test_procs[1].m_pid=(U32)(2);
-	g_test_procs[1].m_priority=LOW;
+	g_test_procs[1].m_priority=MEDIUM;
 	g_test_procs[1].m_stack_size=0x100;
 	
 	g_test_procs[2].m_pid=(U32)(3);
@@ -49,8 +49,8 @@ void set_test_procs() {
 	g_test_procs[5].m_priority=LOW;
 	g_test_procs[5].m_stack_size=0x100;
   
-	g_test_procs[0].mpf_start_pc = &send_delayed_message;
-	g_test_procs[1].mpf_start_pc = &receive_delayed_message;
+	g_test_procs[0].mpf_start_pc = &ping_proc;
+	g_test_procs[1].mpf_start_pc = &pong_proc;
 	g_test_procs[2].mpf_start_pc = &receive_delayed_message_preemption;
 	g_test_procs[3].mpf_start_pc = &send_message_to_blocked;
 	g_test_procs[4].mpf_start_pc = &receive_message_to_blocked;
@@ -62,26 +62,70 @@ void set_test_procs() {
 Timing anaylsis
 Proc 5: experiment 1
 Proc 6: experiment 2
+Proc 1 and 2: experiment 3, ping-pong round trips
 
 */
 
 // Assuming pid 1
-void send_delayed_message(void)
+// Times a round trip to proc 2 with send_message/receive_message, then with send_receive/reply
+void ping_proc(void)
 {
+	int start;
+	int finish;
+	int async;
+	int sync;
+	int i;
+	char msg = 'x';
+	ENVELOPE* message;
+	
+	printf("Proc 1\n\r");
+	for (i = 0; i < 29; i++){
+		message = (ENVELOPE*) request_memory_block();
+		message->sender_pid = 1;
+		message->destination_pid = 2;
+		message->nextMsg = NULL;
+		message->message_type = 0;
+		set_message(message, &msg, sizeof(char));
+		
+		start = *function_timer;
+		send_message(2, message);
+		message = receive_message(NULL);
+		finish = *function_timer;
+		async = finish - start;
+		
+		message->message_type = 1;
+		start = *function_timer;
+		message = send_receive(2, message);
+		finish = *function_timer;
+		sync = finish - start;
+		
+		release_memory_block(message);
+		printf("%d,%d\n\r", async, sync);
+	}
 	while (1)
 	{
-			release_processor();
+		release_processor();
 	}	
 }
 
-
-
 // Assuming pid 2
-void receive_delayed_message(void)
+// Echoes every message back to proc 1, replying to the ones of type 1
+void pong_proc(void)
 {
+	ENVELOPE* message;
 	while (1)
 	{
-		release_processor();
+		message = receive_message(NULL);
+		if (message->message_type == 1)
+		{
+			reply(message);
+		}
+		else
+		{
+			message->sender_pid = 2;
+			message->destination_pid = 1;
+			send_message(1, message);
+		}
 	}	
 }
 
@@ -131,7 +175,6 @@ void receive_message_to_blocked(void)
 		message->destination_pid = 6;
 		message->nextMsg = NULL;
 		message->message_type = 0;
-		message->delay = 0;
 		set_message(message, &msg, sizeof(char));
 
 		start = *function_timer;
@@ -179,7 +222,6 @@ void request_all_memory_block(void)
 		message->destination_pid = 6;
 		message->nextMsg = NULL;
 		message->message_type = 0;
-		message->delay = 0;
 		set_message(message, &msg, sizeof(char));
 
 		start = *function_timer;
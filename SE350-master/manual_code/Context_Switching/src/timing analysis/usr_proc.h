@@ -9,8 +9,8 @@
 #define USR_PROC_H
 
 void set_test_procs(void);
-void send_delayed_message(void);
-void receive_delayed_message(void);
+void ping_proc(void);
+void pong_proc(void);
 void receive_delayed_message_preemption(void);
 void request_all_memory_block(void);
 
@@ -85,9 +85,10 @@ void send_delayed_message(void)
 	message->destination_pid = receiver_pid;
 	message->nextMsg = NULL;
 	message->message_type = 0;
-	message->delay = 0;
 	set_message(message, &msg2, sizeof(char));
 	result1 = delayed_send(receiver_pid, message, 6000);
+	if (result1 != 0)
+		release_memory_block(message);
 	
 	receiver_pid = 2;
 	message = (ENVELOPE*) request_memory_block();
@@ -95,9 +96,10 @@ void send_delayed_message(void)
 	message->destination_pid = receiver_pid;
 	message->nextMsg = NULL;
 	message->message_type = 0;
-	message->delay = 0;
 	set_message(message, &msg3, sizeof(char));
 	result2 = delayed_send(receiver_pid, message, 4000);
+	if (result2 != 0)
+		release_memory_block(message);
 	if (result1 == 0 && result2 == 0)
 	{
 		uart0_put_string("G009_test: test 1 OK\n\r");
@@ -119,7 +121,7 @@ void send_delayed_message(void)
 void receive_delayed_message(void)
 {
 	ENVELOPE* message = receive_message(NULL);
-	char* char_message = (char*) message->message;
+	char* char_message = (char*) msg_payload(message);
 	if (*char_message == 'y') 
 	{
 		uart0_put_string("G009_test: test 2 OK\n\r");
@@ -141,7 +143,7 @@ void receive_delayed_message(void)
 void receive_delayed_message_preemption(void)
 {
 	ENVELOPE* message = receive_message(NULL);
-	char* char_message = (char*) message->message;
+	char* char_message = (char*) msg_payload(message);
 	
 	if (*char_message == 'x') 
 	{
@@ -177,7 +179,6 @@ void send_message_to_blocked(void)
 	message->destination_pid = receiver_pid;
 	message->nextMsg = NULL;
 	message->message_type = 0;
-	message->delay = 0;
 	set_message(message, &msg, sizeof(char));
 	result = send_message(receiver_pid, message);
 	
@@ -205,7 +206,7 @@ void receive_message_to_blocked(void)
 	int sender_pid = 4;
 	int receiver_pid = 5;
 	ENVELOPE* message = receive_message(NULL);
-	char* char_message = (char*) message->message;
+	char* char_message = (char*) msg_payload(message);
 	// Change this depending on the pid of this test
 	if (*char_message == 'x') 
 	{